@@ -0,0 +1,232 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+
+
+// Writes a synthetic project the size of a multi-hour encode and times
+// readProject on it, next to a plain rapidjson DOM parse of the same file,
+// which is where the old loader spent most of its time and memory. Only
+// the public WobblyProject API is used, so this file also builds against
+// older revisions for an end to end comparison.
+//
+// Usage: project-load-benchmark [frames]
+//
+// Exits with 1 if the loaded project doesn't match the one written.
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#define RAPIDJSON_NAMESPACE rj
+
+#include "rapidjson/document.h"
+
+#include "FrozenFramesModel.h"
+#include "SectionsModel.h"
+#include "WobblyException.h"
+#include "WobblyProject.h"
+
+
+// About five hours at 29.97 fps.
+#define DEFAULT_NUM_FRAMES 500000
+
+#define NUM_RUNS 3
+
+
+static WobblyProject *createProject(int num_frames) {
+    WobblyProject *project = new WobblyProject(true, "synthetic.d2v", "d2v.Source", 30000, 1001, 720, 480, num_frames);
+
+    std::mt19937 rng(1);
+
+    project->beginBulkUpdate();
+
+    project->addPreset("deblock", "clip = core.std.BlankClip(clip)");
+
+    for (int frame = 0; frame < num_frames; frame++) {
+        project->setOriginalMatch(frame, "ccccccnnpb"[rng() % 10]);
+
+        project->setMics(frame, rng() % 60, rng() % 60, rng() % 60, rng() % 60, rng() % 60);
+        project->setDMetrics(frame, rng() % 100000, rng() % 100000, rng() % 10000, rng() % 10000);
+        project->setDecimateMetric(frame, rng() % 50000);
+
+        if (frame % 5 == 4)
+            project->addDecimatedFrame(frame - rng() % 5);
+
+        if (rng() % 40 == 0)
+            project->addCombedFrame(frame);
+
+        if (frame > 0 && rng() % 1500 == 0) {
+            project->addSection(frame);
+
+            if (rng() % 4 == 0)
+                project->setSectionPreset(frame, "deblock");
+        }
+
+        if (frame % 2000 == 1000)
+            project->addFreezeFrame(frame, frame + rng() % 10, frame - 1);
+    }
+
+    project->resetRangeMatches(0, num_frames - 1);
+
+    // Some hand made changes, like a user would make in Wobbly.
+    for (int frame = 0; frame < num_frames; frame += 97)
+        project->setMatch(frame, 'n');
+
+    project->endBulkUpdate();
+
+    return project;
+}
+
+
+static bool compareProjects(WobblyProject *expected, WobblyProject *loaded) {
+    int num_frames = expected->getNumFrames(PostSource);
+
+    if (loaded->getNumFrames(PostSource) != num_frames ||
+        loaded->getNumFrames(PostDecimate) != expected->getNumFrames(PostDecimate)) {
+        fprintf(stderr, "The loaded project has the wrong number of frames.\n");
+        return false;
+    }
+
+    for (int frame = 0; frame < num_frames; frame++) {
+        if (loaded->getOriginalMatch(frame) != expected->getOriginalMatch(frame) ||
+            loaded->getMatch(frame) != expected->getMatch(frame) ||
+            loaded->getMics(frame) != expected->getMics(frame) ||
+            loaded->getMMetrics(frame) != expected->getMMetrics(frame) ||
+            loaded->getVMetrics(frame) != expected->getVMetrics(frame) ||
+            loaded->getDecimateMetric(frame) != expected->getDecimateMetric(frame) ||
+            loaded->isDecimatedFrame(frame) != expected->isDecimatedFrame(frame) ||
+            loaded->isCombedFrame(frame) != expected->isCombedFrame(frame)) {
+            fprintf(stderr, "The loaded project differs from the one written at frame %d.\n", frame);
+            return false;
+        }
+    }
+
+    if ((const SectionMap &)*loaded->getSectionsModel() != (const SectionMap &)*expected->getSectionsModel()) {
+        fprintf(stderr, "The loaded project has different sections.\n");
+        return false;
+    }
+
+    if ((const FreezeFrameMap &)*loaded->getFrozenFramesModel() != (const FreezeFrameMap &)*expected->getFrozenFramesModel()) {
+        fprintf(stderr, "The loaded project has different frozen frames.\n");
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool timeLoading(WobblyProject *expected, const QString &path, const char *name) {
+    double dom_milliseconds = 1e300;
+    double read_milliseconds = 1e300;
+
+    for (int run = 0; run < NUM_RUNS; run++) {
+        QElapsedTimer timer;
+        timer.start();
+
+        {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly))
+                throw WobblyException("Couldn't open project file '" + path + "'. Error message: " + file.errorString());
+
+            QByteArray file_contents = file.readAll();
+
+            rj::Document json_project;
+            if (json_project.ParseInsitu(file_contents.data()).HasParseError())
+                throw WobblyException("Failed to parse project file '" + path + "'.");
+        }
+
+        dom_milliseconds = std::min(dom_milliseconds, timer.nsecsElapsed() / 1e6);
+
+        timer.restart();
+
+        WobblyProject loaded(true);
+        loaded.readProject(path.toStdString());
+
+        read_milliseconds = std::min(read_milliseconds, timer.nsecsElapsed() / 1e6);
+
+        if (run == 0 && !compareProjects(expected, &loaded))
+            return false;
+    }
+
+    printf("%-8s %7.1f MiB   DOM parse only %8.1f ms   readProject %8.1f ms\n", name, QFileInfo(path).size() / 1048576.0, dom_milliseconds, read_milliseconds);
+
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    int num_frames = DEFAULT_NUM_FRAMES;
+    if (argc > 1)
+        num_frames = std::atoi(argv[1]);
+
+    if (num_frames < 1) {
+        fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+        return 2;
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        fprintf(stderr, "Couldn't create a temporary directory.\n");
+        return 1;
+    }
+
+    try {
+        QElapsedTimer timer;
+        timer.start();
+
+        WobblyProject *project = createProject(num_frames);
+
+        printf("Created a project with %d frames in %.1f ms.\n\n", num_frames, timer.nsecsElapsed() / 1e6);
+
+        QString json_path = dir.filePath("synthetic.json");
+        QString columns_path = dir.filePath("synthetic-columns.json");
+
+        timer.restart();
+        project->writeProject(json_path.toStdString(), false);
+        double json_milliseconds = timer.nsecsElapsed() / 1e6;
+
+        timer.restart();
+        project->writeProject(columns_path.toStdString(), false, true);
+        double columns_milliseconds = timer.nsecsElapsed() / 1e6;
+
+        printf("writeProject: %.1f ms as JSON, %.1f ms with binary columns.\n\n", json_milliseconds, columns_milliseconds);
+
+        bool ok = timeLoading(project, json_path, "JSON") &&
+                  timeLoading(project, columns_path, "columns");
+
+        delete project;
+
+        return ok ? 0 : 1;
+    } catch (WobblyException &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
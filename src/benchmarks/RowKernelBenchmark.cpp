@@ -0,0 +1,173 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+// Checks the vectorised row kernels of packRGBFrame and of the field
+// difference filter against their plain C loops, and times them on 1080p
+// and 4K frames. Exits with 1 if any kernel is wrong.
+
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <QElapsedTimer>
+
+#include "WobblyFilters.h"
+#include "WobblyShared.h"
+
+
+// Bytes after the end of each row, which no kernel may touch.
+#define GUARD_SIZE 64
+
+#define MAX_CHECKED_WIDTH 256
+
+// Rows that don't start on a vector boundary are checked too.
+#define MAX_CHECKED_OFFSET 31
+
+
+static std::vector<uint8_t> randomBytes(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = rng();
+
+    return bytes;
+}
+
+
+static bool checkPackKernels(const std::vector<PackRowKernel> &kernels) {
+    std::vector<uint8_t> r = randomBytes(MAX_CHECKED_WIDTH, 1);
+    std::vector<uint8_t> g = randomBytes(MAX_CHECKED_WIDTH, 2);
+    std::vector<uint8_t> b = randomBytes(MAX_CHECKED_WIDTH, 3);
+
+    bool ok = true;
+
+    for (int width = 0; width <= MAX_CHECKED_WIDTH; width++) {
+        std::vector<uint8_t> expected(width * 4 + GUARD_SIZE, 0xcd);
+        kernels[0].func(r.data(), g.data(), b.data(), expected.data(), width);
+
+        for (size_t i = 1; i < kernels.size(); i++) {
+            std::vector<uint8_t> packed(width * 4 + GUARD_SIZE, 0xcd);
+            kernels[i].func(r.data(), g.data(), b.data(), packed.data(), width);
+
+            if (packed != expected) {
+                fprintf(stderr, "pack %s differs from %s at width %d.\n", kernels[i].name, kernels[0].name, width);
+                ok = false;
+            }
+        }
+    }
+
+    return ok;
+}
+
+
+static bool checkSumKernels(const std::vector<SumRowKernel> &kernels) {
+    std::vector<uint8_t> row = randomBytes(MAX_CHECKED_OFFSET + MAX_CHECKED_WIDTH, 4);
+
+    // The sums of 8 bit lanes must not wrap anywhere.
+    std::vector<uint8_t> white(MAX_CHECKED_OFFSET + MAX_CHECKED_WIDTH, 255);
+
+    bool ok = true;
+
+    for (const std::vector<uint8_t> *data : { &row, &white }) {
+        for (int offset = 0; offset <= MAX_CHECKED_OFFSET; offset++) {
+            for (int width = 0; width <= MAX_CHECKED_WIDTH; width++) {
+                uint64_t expected = kernels[0].func(data->data() + offset, width);
+
+                for (size_t i = 1; i < kernels.size(); i++) {
+                    if (kernels[i].func(data->data() + offset, width) != expected) {
+                        fprintf(stderr, "sum %s differs from %s at width %d, offset %d.\n", kernels[i].name, kernels[0].name, width, offset);
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+
+    return ok;
+}
+
+
+// Runs kernel once per row of num_frames frames, and prints how long a frame took.
+template <typename Kernel, typename Row>
+static void timeKernels(const std::vector<Kernel> &kernels, const char *what, const char *name, int height, int num_frames, Row row) {
+    double c_milliseconds = 0;
+
+    for (const Kernel &kernel : kernels) {
+        // Once to get everything in memory.
+        for (int y = 0; y < height; y++)
+            row(kernel.func, y);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int frame = 0; frame < num_frames; frame++)
+            for (int y = 0; y < height; y++)
+                row(kernel.func, y);
+
+        double milliseconds = timer.nsecsElapsed() / 1e6 / num_frames;
+
+        if (&kernel == &kernels[0])
+            c_milliseconds = milliseconds;
+
+        printf("%-4s %-6s %-5s %8.3f ms/frame %6.2fx\n", what, name, kernel.name, milliseconds, c_milliseconds / milliseconds);
+    }
+}
+
+
+static void timeAllKernels(const std::vector<PackRowKernel> &pack_kernels, const std::vector<SumRowKernel> &sum_kernels, const char *name, int width, int height, int num_frames) {
+    std::vector<uint8_t> r = randomBytes((size_t)width * height, 5);
+    std::vector<uint8_t> g = randomBytes((size_t)width * height, 6);
+    std::vector<uint8_t> b = randomBytes((size_t)width * height, 7);
+
+    std::vector<uint8_t> dst((size_t)width * height * 4);
+
+    timeKernels(pack_kernels, "pack", name, height, num_frames, [&] (PackRowFunc pack_row, int y) {
+        pack_row(r.data() + (size_t)y * width, g.data() + (size_t)y * width, b.data() + (size_t)y * width, dst.data() + (size_t)y * width * 4, width);
+    });
+
+    // Keeps the sums from being optimised away.
+    volatile uint64_t total = 0;
+
+    timeKernels(sum_kernels, "sum", name, height, num_frames, [&] (SumRowFunc sum_row, int y) {
+        total = total + sum_row(r.data() + (size_t)y * width, width);
+    });
+}
+
+
+int main() {
+    std::vector<PackRowKernel> pack_kernels = getPackRowKernels();
+    std::vector<SumRowKernel> sum_kernels = getSumRowKernels();
+
+    bool pack_ok = checkPackKernels(pack_kernels);
+    bool sum_ok = checkSumKernels(sum_kernels);
+
+    if (!pack_ok || !sum_ok)
+        return 1;
+
+    printf("All kernels match %s for widths 0 to %d.\n\n", pack_kernels[0].name, MAX_CHECKED_WIDTH);
+
+    timeAllKernels(pack_kernels, sum_kernels, "1080p", 1920, 1080, 200);
+    timeAllKernels(pack_kernels, sum_kernels, "4K", 3840, 2160, 50);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef BATCHABLEMODEL_H
+#define BATCHABLEMODEL_H
+
+#include <QAbstractItemModel>
+
+
+// A model that can take a batch of changes without announcing every row.
+// Views and proxies do a lot of work per row, so past a certain number of
+// changes the rest of the batch becomes a single model reset.
+//
+// Hides the row notification functions of Model, so the derived models
+// call them as before. dataChanged is a signal, so use emitDataChanged.
+template <typename Model>
+class BatchableModel : public Model {
+    // Below this many changes a batch keeps the views' selection and scroll position.
+    static constexpr int reset_threshold = 100;
+
+    int batch_depth = 0;
+    int batch_changes = 0;
+    bool resetting = false;
+
+
+    // False if the change is part of a reset instead.
+    bool announceChange() {
+        if (resetting)
+            return false;
+
+        if (batch_depth && ++batch_changes > reset_threshold) {
+            Model::beginResetModel();
+            resetting = true;
+            return false;
+        }
+
+        return true;
+    }
+
+public:
+    using Model::Model;
+
+
+    // Batches can nest. The outermost one ends the reset.
+    void beginBatch() {
+        batch_depth++;
+    }
+
+    void endBatch() {
+        if (--batch_depth)
+            return;
+
+        batch_changes = 0;
+
+        if (resetting) {
+            resetting = false;
+            Model::endResetModel();
+        }
+    }
+
+protected:
+    void beginInsertRows(const QModelIndex &parent, int first, int last) {
+        if (announceChange())
+            Model::beginInsertRows(parent, first, last);
+    }
+
+    void endInsertRows() {
+        if (!resetting)
+            Model::endInsertRows();
+    }
+
+    void beginRemoveRows(const QModelIndex &parent, int first, int last) {
+        if (announceChange())
+            Model::beginRemoveRows(parent, first, last);
+    }
+
+    void endRemoveRows() {
+        if (!resetting)
+            Model::endRemoveRows();
+    }
+
+    bool beginMoveRows(const QModelIndex &source_parent, int source_first, int source_last, const QModelIndex &destination_parent, int destination_child) {
+        if (announceChange())
+            return Model::beginMoveRows(source_parent, source_first, source_last, destination_parent, destination_child);
+
+        return true;
+    }
+
+    void endMoveRows() {
+        if (!resetting)
+            Model::endMoveRows();
+    }
+
+    void emitDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right) {
+        if (announceChange())
+            emit Model::dataChanged(top_left, bottom_right);
+    }
+};
+
+#endif // BATCHABLEMODEL_H
@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef BLOCKMAXINDEX_H
+#define BLOCKMAXINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+// An array of values together with the maximum of every block of
+// block_size values, so that searching for the next value at or above
+// some threshold can skip whole blocks.
+template <typename T>
+class BlockMaxIndex {
+    static constexpr int block_size = 256;
+
+    std::vector<T> values;
+    std::vector<T> block_max;
+
+
+    void updateBlock(size_t block) {
+        size_t start = block * block_size;
+        size_t end = std::min(start + block_size, values.size());
+
+        block_max[block] = *std::max_element(values.begin() + start, values.begin() + end);
+    }
+
+public:
+    void assign(std::vector<T> &&new_values) {
+        values = std::move(new_values);
+        block_max.resize((values.size() + block_size - 1) / block_size);
+
+        for (size_t i = 0; i < block_max.size(); i++)
+            updateBlock(i);
+    }
+
+    size_t size() const {
+        return values.size();
+    }
+
+    T operator[](size_t index) const {
+        return values[index];
+    }
+
+    void set(size_t index, T value) {
+        T old_value = values[index];
+        values[index] = value;
+
+        T &max = block_max[index / block_size];
+        if (value >= max)
+            max = value;
+        else if (old_value == max)
+            updateBlock(index / block_size);
+    }
+
+    // The first index >= start whose value is >= minimum, or -1.
+    int findNext(int start, int minimum) const {
+        for (int i = std::max(start, 0); i < (int)values.size(); ) {
+            if (block_max[i / block_size] < minimum) {
+                i = (i / block_size + 1) * block_size;
+                continue;
+            }
+
+            if (values[i] >= minimum)
+                return i;
+
+            i++;
+        }
+
+        return -1;
+    }
+
+    // The last index <= start whose value is >= minimum, or -1.
+    int findPrevious(int start, int minimum) const {
+        for (int i = std::min(start, (int)values.size() - 1); i >= 0; ) {
+            if (block_max[i / block_size] < minimum) {
+                i = (i / block_size) * block_size - 1;
+                continue;
+            }
+
+            if (values[i] >= minimum)
+                return i;
+
+            i--;
+        }
+
+        return -1;
+    }
+};
+
+#endif // BLOCKMAXINDEX_H
@@ -21,7 +21,7 @@ SOFTWARE.
 #include "BookmarksModel.h"
 
 BookmarksModel::BookmarksModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : BatchableModel<QAbstractTableModel>(parent)
 {
 
 }
@@ -92,7 +92,7 @@ bool BookmarksModel::setData(const QModelIndex &index, const QVariant &value, in
 
         it->second.description = value.toString().toStdString();
 
-        emit dataChanged(index, index);
+        emitDataChanged(index, index);
 
         return true;
     }
@@ -23,10 +23,11 @@ SOFTWARE.
 
 #include <QAbstractTableModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class BookmarksModel : public QAbstractTableModel, public BookmarkMap {
+class BookmarksModel : public BatchableModel<QAbstractTableModel>, public BookmarkMap {
     Q_OBJECT
 
 public:
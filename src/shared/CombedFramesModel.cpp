@@ -21,7 +21,7 @@ SOFTWARE.
 #include "CombedFramesModel.h"
 
 CombedFramesModel::CombedFramesModel(QObject *parent)
-    : QAbstractListModel(parent)
+    : BatchableModel<QAbstractListModel>(parent)
 {
 
 }
@@ -60,7 +60,7 @@ QVariant CombedFramesModel::headerData(int section, Qt::Orientation orientation,
 
 
 void CombedFramesModel::insert(int frame) {
-    std::set<int>::const_iterator it = lower_bound(frame);
+    CombedFrameSet::const_iterator it = lower_bound(frame);
 
     if (it != cend() && *it == frame)
         return;
@@ -71,14 +71,14 @@ void CombedFramesModel::insert(int frame) {
 
     beginInsertRows(QModelIndex(), new_row, new_row);
 
-    std::set<int>::insert(it, frame);
+    CombedFrameSet::insert(it, frame);
 
     endInsertRows();
 }
 
 
 void CombedFramesModel::erase(int frame) {
-    std::set<int>::const_iterator it = find(frame);
+    CombedFrameSet::const_iterator it = find(frame);
 
     if (it == cend())
         return;
@@ -87,7 +87,7 @@ void CombedFramesModel::erase(int frame) {
 
     beginRemoveRows(QModelIndex(), row, row);
 
-    std::set<int>::erase(it);
+    CombedFrameSet::erase(it);
 
     endRemoveRows();
 }
@@ -99,7 +99,7 @@ void CombedFramesModel::clear() {
 
     beginRemoveRows(QModelIndex(), 0, size() - 1);
 
-    std::set<int>::clear();
+    CombedFrameSet::clear();
 
     endRemoveRows();
 }
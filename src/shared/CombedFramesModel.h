@@ -21,12 +21,16 @@ SOFTWARE.
 #ifndef COMBEDFRAMESMODEL_H
 #define COMBEDFRAMESMODEL_H
 
-#include <set>
-
 #include <QAbstractListModel>
 
+#include "BatchableModel.h"
+#include "SortedVector.h"
+
+
+typedef FlatSet<int> CombedFrameSet;
+
 
-class CombedFramesModel : public QAbstractListModel, public std::set<int> {
+class CombedFramesModel : public BatchableModel<QAbstractListModel>, public CombedFrameSet {
     Q_OBJECT
 
 public:
@@ -38,13 +42,13 @@ public:
 
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
-    using std::set<int>::cbegin;
-    using std::set<int>::cend;
-    using std::set<int>::count;
-    using std::set<int>::lower_bound;
-    using std::set<int>::upper_bound;
-    using std::set<int>::size;
-    using std::set<int>::const_iterator;
+    using CombedFrameSet::cbegin;
+    using CombedFrameSet::cend;
+    using CombedFrameSet::count;
+    using CombedFrameSet::lower_bound;
+    using CombedFrameSet::upper_bound;
+    using CombedFrameSet::size;
+    using CombedFrameSet::const_iterator;
 
     void insert(int frame);
 
@@ -21,7 +21,7 @@ SOFTWARE.
 #include "CustomListsModel.h"
 
 CustomListsModel::CustomListsModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : BatchableModel<QAbstractTableModel>(parent)
 {
 
 }
@@ -136,7 +136,7 @@ void CustomListsModel::setCustomListName(int list_index, const std::string &name
     at(list_index).name = name;
 
     QModelIndex cell = index(list_index, NameColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -144,7 +144,7 @@ void CustomListsModel::setCustomListPreset(int list_index, const std::string &pr
     at(list_index).preset = preset_name;
 
     QModelIndex cell = index(list_index, PresetColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -152,5 +152,5 @@ void CustomListsModel::setCustomListPosition(int list_index, PositionInFilterCha
     at(list_index).position = position;
 
     QModelIndex cell = index(list_index, PositionColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
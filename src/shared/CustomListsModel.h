@@ -23,10 +23,11 @@ SOFTWARE.
 
 #include <QAbstractTableModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class CustomListsModel : public QAbstractTableModel, public CustomListVector {
+class CustomListsModel : public BatchableModel<QAbstractTableModel>, public CustomListVector {
     Q_OBJECT
 
     enum Columns {
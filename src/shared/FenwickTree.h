@@ -0,0 +1,85 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef FENWICKTREE_H
+#define FENWICKTREE_H
+
+#include <cstddef>
+#include <vector>
+
+
+// Prefix sums over an array of non-negative integers, with O(log n)
+// updates and queries.
+class FenwickTree {
+    std::vector<int> tree; // 1-based.
+
+public:
+    // Builds the tree from values in O(n).
+    void assign(const std::vector<int> &values) {
+        tree.assign(values.size() + 1, 0);
+
+        for (size_t i = 1; i < tree.size(); i++) {
+            tree[i] += values[i - 1];
+
+            size_t parent = i + (i & -i);
+            if (parent < tree.size())
+                tree[parent] += tree[i];
+        }
+    }
+
+    size_t size() const {
+        return tree.size() ? tree.size() - 1 : 0;
+    }
+
+    void add(size_t index, int delta) {
+        for (size_t i = index + 1; i < tree.size(); i += i & -i)
+            tree[i] += delta;
+    }
+
+    // Sum of the first count values.
+    int prefixSum(size_t count) const {
+        int sum = 0;
+
+        for (size_t i = count; i > 0; i -= i & -i)
+            sum += tree[i];
+
+        return sum;
+    }
+
+    // The largest count such that prefixSum(count) <= sum.
+    size_t upperBound(int sum) const {
+        size_t count = 0;
+
+        size_t step = 1;
+        while (step * 2 < tree.size())
+            step *= 2;
+
+        for (; step > 0; step /= 2) {
+            if (count + step < tree.size() && tree[count + step] <= sum) {
+                count += step;
+                sum -= tree[count];
+            }
+        }
+
+        return count;
+    }
+};
+
+#endif // FENWICKTREE_H
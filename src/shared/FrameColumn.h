@@ -0,0 +1,125 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef FRAMECOLUMN_H
+#define FRAMECOLUMN_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+// One value per frame. The values either live in a vector owned by the
+// column, or in memory that belongs to someone else, typically a mapped
+// columns file. Borrowed memory is never written to: the first call to
+// one of the non-const accessors copies it into the column's own vector.
+template <typename T>
+class FrameColumn {
+    std::vector<T> values;
+
+    const T *borrowed = nullptr;
+    size_t borrowed_size = 0;
+    std::shared_ptr<const void> owner; // Keeps the borrowed memory alive.
+
+public:
+    typedef T value_type;
+
+    FrameColumn &operator=(const std::vector<T> &new_values) {
+        borrow(nullptr, nullptr, 0);
+        values = new_values;
+        return *this;
+    }
+
+    FrameColumn &operator=(std::vector<T> &&new_values) {
+        borrow(nullptr, nullptr, 0);
+        values = std::move(new_values);
+        return *this;
+    }
+
+    // Uses size elements at data, which must stay valid for as long as
+    // new_owner is alive.
+    void borrow(const std::shared_ptr<const void> &new_owner, const T *data, size_t size) {
+        values.clear();
+        values.shrink_to_fit();
+
+        borrowed = size ? data : nullptr;
+        borrowed_size = borrowed ? size : 0;
+        owner = borrowed ? new_owner : nullptr;
+    }
+
+    size_t size() const {
+        return borrowed ? borrowed_size : values.size();
+    }
+
+    const T *data() const {
+        return borrowed ? borrowed : values.data();
+    }
+
+    const T *cbegin() const {
+        return data();
+    }
+
+    const T *cend() const {
+        return data() + size();
+    }
+
+    const T &operator[](size_t i) const {
+        return data()[i];
+    }
+
+    std::vector<T> toVector() const {
+        return std::vector<T>(cbegin(), cend());
+    }
+
+    // Copies borrowed memory into the column's own vector.
+    void detach() {
+        if (!borrowed)
+            return;
+
+        values.assign(borrowed, borrowed + borrowed_size);
+
+        borrowed = nullptr;
+        borrowed_size = 0;
+        owner.reset();
+    }
+
+    // The non-const accessors detach first.
+
+    T &modify(size_t i) {
+        detach();
+        return values[i];
+    }
+
+    T *mutableData() {
+        detach();
+        return values.data();
+    }
+
+    void resize(size_t size, const T &value) {
+        detach();
+        values.resize(size, value);
+    }
+
+    void clear() {
+        borrow(nullptr, nullptr, 0);
+    }
+};
+
+#endif // FRAMECOLUMN_H
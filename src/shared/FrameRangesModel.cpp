@@ -87,7 +87,7 @@ void FrameRangesModel::insert(const std::pair<int, FrameRange> &range) {
 
     beginInsertRows(QModelIndex(), new_row, new_row);
 
-    std::map<int, FrameRange>::insert(it, range);
+    FrameRangeMap::insert(it, range);
 
     endInsertRows();
 }
@@ -103,7 +103,7 @@ void FrameRangesModel::erase(int frame) {
 
     beginRemoveRows(QModelIndex(), row, row);
 
-    std::map<int, FrameRange>::erase(it);
+    FrameRangeMap::erase(it);
 
     endRemoveRows();
 }
@@ -23,14 +23,20 @@ SOFTWARE.
 
 #include <QAbstractTableModel>
 
+#include "SortedVector.h"
+
 
 struct FrameRange {
     int first;
     int last;
+
+    bool operator==(const FrameRange &) const = default;
 };
 
+typedef FlatMap<int, FrameRange> FrameRangeMap;
+
 
-class FrameRangesModel : public QAbstractTableModel, public std::map<int, FrameRange> {
+class FrameRangesModel : public QAbstractTableModel, public FrameRangeMap {
     Q_OBJECT
 
     enum Columns {
@@ -50,11 +56,11 @@ public:
 
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
-    using std::map<int, FrameRange>::cbegin;
-    using std::map<int, FrameRange>::cend;
-    using std::map<int, FrameRange>::upper_bound;
-    using std::map<int, FrameRange>::count;
-    using std::map<int, FrameRange>::size;
+    using FrameRangeMap::cbegin;
+    using FrameRangeMap::cend;
+    using FrameRangeMap::upper_bound;
+    using FrameRangeMap::count;
+    using FrameRangeMap::size;
 
     void insert(const std::pair<int, FrameRange> &range);
 
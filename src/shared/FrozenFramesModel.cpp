@@ -22,7 +22,7 @@ SOFTWARE.
 
 
 FrozenFramesModel::FrozenFramesModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : BatchableModel<QAbstractTableModel>(parent)
 {
 
 }
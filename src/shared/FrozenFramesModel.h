@@ -21,14 +21,13 @@ SOFTWARE.
 #ifndef FROZENFRAMESMODEL_H
 #define FROZENFRAMESMODEL_H
 
-#include <map>
-
 #include <QAbstractTableModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class FrozenFramesModel : public QAbstractTableModel, public FreezeFrameMap {
+class FrozenFramesModel : public BatchableModel<QAbstractTableModel>, public FreezeFrameMap {
     Q_OBJECT
 
     enum Columns {
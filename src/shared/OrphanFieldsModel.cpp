@@ -21,7 +21,7 @@ SOFTWARE.
 #include "OrphanFieldsModel.h"
 
 OrphanFieldsModel::OrphanFieldsModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : BatchableModel<QAbstractTableModel>(parent)
 {
 
 }
@@ -21,14 +21,13 @@ SOFTWARE.
 #ifndef ORPHANFIELDSMODEL_H
 #define ORPHANFIELDSMODEL_H
 
-#include <map>
-
 #include <QAbstractTableModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class OrphanFieldsModel : public QAbstractTableModel, private OrphanFieldMap {
+class OrphanFieldsModel : public BatchableModel<QAbstractTableModel>, private OrphanFieldMap {
     Q_OBJECT
 
     enum Columns {
@@ -21,7 +21,7 @@ SOFTWARE.
 #include "PresetsModel.h"
 
 PresetsModel::PresetsModel(QObject *parent)
-    : QAbstractListModel(parent)
+    : BatchableModel<QAbstractListModel>(parent)
 {
 
 }
@@ -23,10 +23,11 @@ SOFTWARE.
 
 #include <QAbstractListModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class PresetsModel : public QAbstractListModel, public PresetMap {
+class PresetsModel : public BatchableModel<QAbstractListModel>, public PresetMap {
     Q_OBJECT
 
 public:
@@ -0,0 +1,76 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef ROWKERNELS_H
+#define ROWKERNELS_H
+
+#include <vector>
+
+// ROW_KERNELS_SSE2 and ROW_KERNELS_AVX2 tell which vectorised kernels the
+// build can have. SSE2 is part of every x86-64 CPU, AVX2 is checked when
+// the kernels are listed.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROW_KERNELS_SSE2
+#include <emmintrin.h>
+#define SSE2_KERNEL(func) func
+#else
+#define SSE2_KERNEL(func) nullptr
+#endif
+
+#if defined(ROW_KERNELS_SSE2) && defined(__GNUC__)
+#define ROW_KERNELS_AVX2
+#include <immintrin.h>
+#define AVX2_KERNEL(func) func
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_KERNEL(func) nullptr
+#endif
+
+
+// One way of processing a row of pixels.
+template <typename Func>
+struct RowKernel {
+    const char *name;
+    Func func;
+};
+
+
+// The kernels this build has and this CPU can run, starting with the plain
+// C loop. Every kernel gives the same results. The fastest is the last.
+// Wrap the vectorised kernels in SSE2_KERNEL and AVX2_KERNEL, which turn
+// them into nullptr where the build can't have them.
+template <typename Func>
+std::vector<RowKernel<Func> > getRowKernels(Func c, Func sse2, Func avx2) {
+    std::vector<RowKernel<Func> > kernels = { { "C", c } };
+
+    if (sse2)
+        kernels.push_back({ "SSE2", sse2 });
+
+#ifdef ROW_KERNELS_AVX2
+    if (avx2 && __builtin_cpu_supports("avx2"))
+        kernels.push_back({ "AVX2", avx2 });
+#else
+    (void)avx2;
+#endif
+
+    return kernels;
+}
+
+#endif // ROWKERNELS_H
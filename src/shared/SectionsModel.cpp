@@ -21,7 +21,7 @@ SOFTWARE.
 #include "SectionsModel.h"
 
 SectionsModel::SectionsModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : BatchableModel<QAbstractTableModel>(parent)
 {
 
 }
@@ -132,7 +132,7 @@ void SectionsModel::setSectionPresetName(int section_start, size_t preset_index,
     int row = (int)std::distance(begin(), it);
 
     QModelIndex cell = index(row, PresetsColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -144,7 +144,7 @@ void SectionsModel::appendSectionPreset(int section_start, const std::string &pr
     int row = (int)std::distance(begin(), it);
 
     QModelIndex cell = index(row, PresetsColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -156,7 +156,7 @@ void SectionsModel::deleteSectionPreset(int section_start, size_t preset_index)
     int row = (int)std::distance(begin(), it);
 
     QModelIndex cell = index(row, PresetsColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -171,7 +171,7 @@ void SectionsModel::moveSectionPresetUp(int section_start, size_t preset_index)
     int row = (int)std::distance(begin(), it);
 
     QModelIndex cell = index(row, PresetsColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
 
 
@@ -186,5 +186,5 @@ void SectionsModel::moveSectionPresetDown(int section_start, size_t preset_index
     int row = (int)std::distance(begin(), it);
 
     QModelIndex cell = index(row, PresetsColumn);
-    emit dataChanged(cell, cell);
+    emitDataChanged(cell, cell);
 }
@@ -23,10 +23,11 @@ SOFTWARE.
 
 #include <QAbstractTableModel>
 
+#include "BatchableModel.h"
 #include "WobblyTypes.h"
 
 
-class SectionsModel : public QAbstractTableModel, public SectionMap {
+class SectionsModel : public BatchableModel<QAbstractTableModel>, public SectionMap {
     Q_OBJECT
 
 public:
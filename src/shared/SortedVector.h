@@ -0,0 +1,276 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef SORTEDVECTOR_H
+#define SORTEDVECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+// Elements kept sorted by key in one contiguous vector, with the parts of
+// the std::map/std::set interface the project uses. Lookups are O(log n)
+// and the element in row n is O(1) away, which is what the Qt models
+// built on these need. Insertion and removal move the elements after
+// them, and invalidate iterators and pointers to those elements.
+template <typename Key, typename Value, typename KeyOfValue>
+class SortedVector {
+protected:
+    std::vector<Value> elements;
+
+
+    static bool keyLess(const Value &value, const Key &key) {
+        return KeyOfValue()(value) < key;
+    }
+
+    static bool keyGreater(const Key &key, const Value &value) {
+        return key < KeyOfValue()(value);
+    }
+
+public:
+    typedef Key key_type;
+    typedef Value value_type;
+    typedef size_t size_type;
+    typedef typename std::vector<Value>::iterator iterator;
+    typedef typename std::vector<Value>::const_iterator const_iterator;
+    typedef typename std::vector<Value>::reverse_iterator reverse_iterator;
+    typedef typename std::vector<Value>::const_reverse_iterator const_reverse_iterator;
+
+
+    iterator begin() { return elements.begin(); }
+    const_iterator begin() const { return elements.cbegin(); }
+    const_iterator cbegin() const { return elements.cbegin(); }
+
+    iterator end() { return elements.end(); }
+    const_iterator end() const { return elements.cend(); }
+    const_iterator cend() const { return elements.cend(); }
+
+    reverse_iterator rbegin() { return elements.rbegin(); }
+    const_reverse_iterator rbegin() const { return elements.crbegin(); }
+    const_reverse_iterator crbegin() const { return elements.crbegin(); }
+
+    reverse_iterator rend() { return elements.rend(); }
+    const_reverse_iterator rend() const { return elements.crend(); }
+    const_reverse_iterator crend() const { return elements.crend(); }
+
+
+    size_type size() const {
+        return elements.size();
+    }
+
+    bool empty() const {
+        return elements.empty();
+    }
+
+    void clear() {
+        elements.clear();
+    }
+
+    void reserve(size_type count) {
+        elements.reserve(count);
+    }
+
+    size_type capacity() const {
+        return elements.capacity();
+    }
+
+
+    iterator lower_bound(const Key &key) {
+        return std::lower_bound(elements.begin(), elements.end(), key, keyLess);
+    }
+
+    const_iterator lower_bound(const Key &key) const {
+        return std::lower_bound(elements.cbegin(), elements.cend(), key, keyLess);
+    }
+
+    iterator upper_bound(const Key &key) {
+        return std::upper_bound(elements.begin(), elements.end(), key, keyGreater);
+    }
+
+    const_iterator upper_bound(const Key &key) const {
+        return std::upper_bound(elements.cbegin(), elements.cend(), key, keyGreater);
+    }
+
+    iterator find(const Key &key) {
+        iterator it = lower_bound(key);
+
+        if (it != end() && !(key < KeyOfValue()(*it)))
+            return it;
+
+        return end();
+    }
+
+    const_iterator find(const Key &key) const {
+        const_iterator it = lower_bound(key);
+
+        if (it != cend() && !(key < KeyOfValue()(*it)))
+            return it;
+
+        return cend();
+    }
+
+    size_type count(const Key &key) const {
+        return find(key) != cend();
+    }
+
+    bool contains(const Key &key) const {
+        return find(key) != cend();
+    }
+
+
+    // Does nothing if the key is already present, like std::map::insert.
+    std::pair<iterator, bool> insert(const value_type &value) {
+        iterator it = lower_bound(KeyOfValue()(value));
+
+        if (it != end() && !(KeyOfValue()(value) < KeyOfValue()(*it)))
+            return { it, false };
+
+        return { elements.insert(it, value), true };
+    }
+
+    // The hint is used if value belongs right before it.
+    iterator insert(const_iterator hint, const value_type &value) {
+        const Key &key = KeyOfValue()(value);
+
+        bool hint_is_right = (hint == cend() || key < KeyOfValue()(*hint)) &&
+                             (hint == cbegin() || KeyOfValue()(*(hint - 1)) < key);
+
+        if (!hint_is_right)
+            return insert(value).first;
+
+        return elements.insert(hint, value);
+    }
+
+    iterator erase(const_iterator position) {
+        return elements.erase(position);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        return elements.erase(first, last);
+    }
+
+    size_type erase(const Key &key) {
+        const_iterator it = find(key);
+
+        if (it == cend())
+            return 0;
+
+        elements.erase(it);
+
+        return 1;
+    }
+
+    // Erases the elements with the keys of erased, then inserts inserted,
+    // in a single pass. Both must be sorted by key.
+    void eraseAndInsert(const std::vector<Value> &erased, const std::vector<Value> &inserted) {
+        std::vector<Value> result;
+        result.reserve(elements.size() + inserted.size());
+
+        auto e = erased.cbegin();
+        auto i = inserted.cbegin();
+
+        for (auto &element : elements) {
+            const Key &key = KeyOfValue()(element);
+
+            while (e != erased.cend() && KeyOfValue()(*e) < key)
+                e++;
+
+            if (e != erased.cend() && !(key < KeyOfValue()(*e)))
+                continue;
+
+            while (i != inserted.cend() && KeyOfValue()(*i) < key)
+                result.push_back(*i++);
+
+            // Already present, and insert() keeps the old element.
+            if (i != inserted.cend() && !(key < KeyOfValue()(*i)))
+                i++;
+
+            result.push_back(std::move(element));
+        }
+
+        result.insert(result.end(), i, inserted.cend());
+
+        elements = std::move(result);
+    }
+
+
+    bool operator==(const SortedVector &other) const {
+        return elements == other.elements;
+    }
+};
+
+
+struct FirstOfPair {
+    template <typename Key, typename T>
+    const Key &operator()(const std::pair<Key, T> &pair) const {
+        return pair.first;
+    }
+};
+
+
+struct Identity {
+    template <typename T>
+    const T &operator()(const T &value) const {
+        return value;
+    }
+};
+
+
+// Unlike std::map, the keys can be modified through iterators. Don't.
+template <typename Key, typename T>
+class FlatMap : public SortedVector<Key, std::pair<Key, T>, FirstOfPair> {
+    typedef SortedVector<Key, std::pair<Key, T>, FirstOfPair> Base;
+
+public:
+    typedef T mapped_type;
+
+
+    T &at(const Key &key) {
+        typename Base::iterator it = Base::find(key);
+
+        if (it == Base::end())
+            throw std::out_of_range("FlatMap::at");
+
+        return it->second;
+    }
+
+    const T &at(const Key &key) const {
+        typename Base::const_iterator it = Base::find(key);
+
+        if (it == Base::cend())
+            throw std::out_of_range("FlatMap::at");
+
+        return it->second;
+    }
+
+    T &operator[](const Key &key) {
+        return Base::insert(std::make_pair(key, T())).first->second;
+    }
+};
+
+
+template <typename Key>
+class FlatSet : public SortedVector<Key, Key, Identity> {
+};
+
+#endif // SORTEDVECTOR_H
@@ -0,0 +1,444 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "WobblyException.h"
+#include "WobblyFilters.h"
+
+
+bool FrameOverrides::update(const char *new_matches, size_t num_matches, const FreezeFrameMap &new_freeze_frames, bool freeze_frames_wanted, bool new_tff, int *first_changed, int *last_changed) {
+    std::vector<FreezeFrame> wanted_freeze_frames;
+    if (freeze_frames_wanted) {
+        wanted_freeze_frames.reserve(new_freeze_frames.size());
+        for (auto it = new_freeze_frames.cbegin(); it != new_freeze_frames.cend(); it++)
+            wanted_freeze_frames.push_back(it->second);
+    }
+
+    int first = INT_MAX;
+    int last = -1;
+
+    auto changed = [&first, &last] (int changed_first, int changed_last) {
+        first = std::min(first, changed_first);
+        last = std::max(last, changed_last);
+    };
+
+    // Only this thread writes, so reading without the lock is fine.
+    if (tff != new_tff || matches.size() != num_matches) {
+        changed(0, INT_MAX);
+    } else {
+        size_t start = std::mismatch(matches.cbegin(), matches.cend(), new_matches).first - matches.cbegin();
+        size_t end = matches.size();
+
+        while (end > start && matches[end - 1] == new_matches[end - 1])
+            end--;
+
+        if (start < end) {
+            changed((int)start, (int)end - 1);
+
+            // Frozen frames show their replacement's fields.
+            for (const std::vector<FreezeFrame> *ffs : { &freeze_frames, &wanted_freeze_frames })
+                for (const FreezeFrame &ff : *ffs)
+                    if ((size_t)ff.replacement >= start && (size_t)ff.replacement < end)
+                        changed(ff.first, ff.last);
+        }
+    }
+
+    // Both are sorted by first. Freeze frames that were added, removed or
+    // changed affect all their frames.
+    for (size_t i = 0, j = 0; i < freeze_frames.size() || j < wanted_freeze_frames.size(); ) {
+        if (j == wanted_freeze_frames.size() || (i < freeze_frames.size() && freeze_frames[i].first < wanted_freeze_frames[j].first)) {
+            changed(freeze_frames[i].first, freeze_frames[i].last);
+            i++;
+        } else if (i == freeze_frames.size() || wanted_freeze_frames[j].first < freeze_frames[i].first) {
+            changed(wanted_freeze_frames[j].first, wanted_freeze_frames[j].last);
+            j++;
+        } else {
+            if (!(freeze_frames[i] == wanted_freeze_frames[j])) {
+                changed(freeze_frames[i].first, freeze_frames[i].last);
+                changed(wanted_freeze_frames[j].first, wanted_freeze_frames[j].last);
+            }
+            i++;
+            j++;
+        }
+    }
+
+    if (first > last)
+        return false;
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    matches.assign(new_matches, new_matches + num_matches);
+    freeze_frames = std::move(wanted_freeze_frames);
+    tff = new_tff;
+
+    *first_changed = first;
+    *last_changed = last;
+
+    return true;
+}
+
+
+void FrameOverrides::getFieldSources(int n, int num_frames, int *frame, int *top, int *bottom) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+
+    auto it = std::upper_bound(freeze_frames.cbegin(), freeze_frames.cend(), n, [] (int value, const FreezeFrame &ff) {
+        return value < ff.first;
+    });
+    if (it != freeze_frames.cbegin()) {
+        it--;
+        if (it->first <= n && n <= it->last)
+            n = it->replacement;
+    }
+
+    char match = 'c';
+    if ((size_t)n < matches.size())
+        match = matches[n];
+
+    // The field that is kept is the bottom one when the source is top field first.
+    int kept = n;
+    int other = n;
+
+    if (match == 'p' || match == 'b')
+        other = n - 1;
+    else if (match == 'n' || match == 'u')
+        other = n + 1;
+
+    other = std::max(0, std::min(other, num_frames - 1));
+
+    bool other_is_top = (match == 'p' || match == 'n') == tff;
+
+    *frame = n;
+    *top = other_is_top ? other : kept;
+    *bottom = other_is_top ? kept : other;
+}
+
+
+struct OverridesData {
+    VSNode *clip;
+    VSVideoInfo vi;
+    std::shared_ptr<FrameOverrides> overrides;
+};
+
+
+static const VSFrame *VS_CC overridesGetFrame(int n, int activation_reason, void *instance_data, void **frame_data, VSFrameContext *frame_ctx, VSCore *core, const VSAPI *vsapi) {
+    OverridesData *d = (OverridesData *)instance_data;
+
+    if (activation_reason == arInitial) {
+        int frame, top, bottom;
+        d->overrides->getFieldSources(n, d->vi.numFrames, &frame, &top, &bottom);
+
+        // The table can change before the frames arrive, so remember what was requested.
+        frame_data[0] = (void *)(intptr_t)frame;
+        frame_data[1] = (void *)(intptr_t)top;
+        frame_data[2] = (void *)(intptr_t)bottom;
+
+        vsapi->requestFrameFilter(frame, d->clip, frame_ctx);
+        if (top != frame)
+            vsapi->requestFrameFilter(top, d->clip, frame_ctx);
+        if (bottom != frame)
+            vsapi->requestFrameFilter(bottom, d->clip, frame_ctx);
+    } else if (activation_reason == arAllFramesReady) {
+        int frame = (int)(intptr_t)frame_data[0];
+        int top = (int)(intptr_t)frame_data[1];
+        int bottom = (int)(intptr_t)frame_data[2];
+
+        const VSFrame *src = vsapi->getFrameFilter(frame, d->clip, frame_ctx);
+
+        if (top == frame && bottom == frame)
+            return src;
+
+        const VSFrame *fields[2] = {
+            vsapi->getFrameFilter(top, d->clip, frame_ctx),
+            vsapi->getFrameFilter(bottom, d->clip, frame_ctx)
+        };
+
+        const VSVideoFormat *format = vsapi->getVideoFrameFormat(src);
+
+        VSFrame *dst = vsapi->newVideoFrame(format, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), src, core);
+
+        for (int plane = 0; plane < format->numPlanes; plane++) {
+            size_t row_size = vsapi->getFrameWidth(dst, plane) * format->bytesPerSample;
+            int height = vsapi->getFrameHeight(dst, plane);
+            ptrdiff_t dst_stride = vsapi->getStride(dst, plane);
+            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+
+            for (int field = 0; field < 2; field++) {
+                const uint8_t *srcp = vsapi->getReadPtr(fields[field], plane);
+                ptrdiff_t src_stride = vsapi->getStride(fields[field], plane);
+
+                for (int y = field; y < height; y += 2)
+                    memcpy(dstp + y * dst_stride, srcp + y * src_stride, row_size);
+            }
+        }
+
+        vsapi->freeFrame(src);
+        vsapi->freeFrame(fields[0]);
+        vsapi->freeFrame(fields[1]);
+
+        return dst;
+    }
+
+    return nullptr;
+}
+
+
+static void VS_CC overridesFree(void *instance_data, VSCore *, const VSAPI *vsapi) {
+    OverridesData *d = (OverridesData *)instance_data;
+
+    vsapi->freeNode(d->clip);
+
+    delete d;
+}
+
+
+VSNode *createOverridesFilter(const VSAPI *vsapi, VSCore *vscore, VSNode *clip, const std::shared_ptr<FrameOverrides> &overrides) {
+    const VSVideoInfo *vi = vsapi->getVideoInfo(clip);
+
+    if (vi->format.colorFamily == cfUndefined || !vi->width || !vi->height)
+        throw WobblyException("Can't create the overrides filter: the clip must have constant format and dimensions.");
+
+    OverridesData *d = new OverridesData{ vsapi->addNodeRef(clip), *vi, overrides };
+
+    VSFilterDependency deps[] = { { d->clip, rpGeneral } };
+
+    return vsapi->createVideoFilter2("WobblyOverrides", &d->vi, overridesGetFrame, overridesFree, fmParallel, deps, 1, d, vscore);
+}
+
+
+static uint64_t sumRowC(const uint8_t *row, int width) {
+    uint64_t sum = 0;
+
+    for (int x = 0; x < width; x++)
+        sum += row[x];
+
+    return sum;
+}
+
+#ifdef ROW_KERNELS_SSE2
+static uint64_t sumRowSSE2(const uint8_t *row, int width) {
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i sums = zero;
+
+    int x = 0;
+
+    // psadbw against zero adds up each group of 8 bytes.
+    for (; x + 16 <= width; x += 16)
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(row + x)), zero));
+
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128((__m128i *)lanes, sums);
+
+    return lanes[0] + lanes[1] + sumRowC(row + x, width - x);
+}
+#endif
+
+#ifdef ROW_KERNELS_AVX2
+AVX2_TARGET
+static uint64_t sumRowAVX2(const uint8_t *row, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i sums = zero;
+
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32)
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(row + x)), zero));
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256((__m256i *)lanes, sums);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumRowSSE2(row + x, width - x);
+}
+#endif
+
+std::vector<SumRowKernel> getSumRowKernels() {
+    return getRowKernels<SumRowFunc>(sumRowC, SSE2_KERNEL(sumRowSSE2), AVX2_KERNEL(sumRowAVX2));
+}
+
+
+// Adds up the top field's lines in sums[0] and the bottom field's in sums[1], in one pass.
+template <typename T, typename Sum>
+static void sumFields(const uint8_t *ptr, ptrdiff_t stride, int width, int height, Sum sums[2]) {
+    for (int y = 0; y < height; y++) {
+        const T *row = (const T *)(ptr + y * stride);
+
+        Sum sum = 0;
+        for (int x = 0; x < width; x++)
+            sum += row[x];
+
+        sums[y & 1] += sum;
+    }
+}
+
+
+static double getFieldDifference(const VSAPI *vsapi, const VSFrame *frame) {
+    static const SumRowFunc sumRow = getSumRowKernels().back().func;
+
+    const VSVideoFormat *format = vsapi->getVideoFrameFormat(frame);
+
+    const uint8_t *ptr = vsapi->getReadPtr(frame, 0);
+    ptrdiff_t stride = vsapi->getStride(frame, 0);
+    int width = vsapi->getFrameWidth(frame, 0);
+    int height = vsapi->getFrameHeight(frame, 0);
+
+    if (height < 2)
+        return 0;
+
+    // The top field gets the extra line if there is one.
+    double pixels[2] = { (double)width * ((height + 1) / 2), (double)width * (height / 2) };
+
+    double averages[2];
+
+    if (format->sampleType == stFloat) {
+        double sums[2] = { 0, 0 };
+        sumFields<float>(ptr, stride, width, height, sums);
+
+        for (int field = 0; field < 2; field++)
+            averages[field] = sums[field] / pixels[field];
+    } else {
+        uint64_t sums[2] = { 0, 0 };
+
+        if (format->bytesPerSample == 1) {
+            for (int y = 0; y < height; y++)
+                sums[y & 1] += sumRow(ptr + y * stride, width);
+        } else {
+            sumFields<uint16_t>(ptr, stride, width, height, sums);
+        }
+
+        double maximum = (double)((1 << format->bitsPerSample) - 1);
+
+        for (int field = 0; field < 2; field++)
+            averages[field] = sums[field] / pixels[field] / maximum;
+    }
+
+    return std::abs(averages[0] - averages[1]);
+}
+
+
+struct FieldDifferenceData {
+    VSNode *clip;
+    VSVideoInfo vi;
+};
+
+
+static const VSFrame *VS_CC fieldDifferenceGetFrame(int n, int activation_reason, void *instance_data, void **, VSFrameContext *frame_ctx, VSCore *core, const VSAPI *vsapi) {
+    FieldDifferenceData *d = (FieldDifferenceData *)instance_data;
+
+    if (activation_reason == arInitial) {
+        vsapi->requestFrameFilter(n, d->clip, frame_ctx);
+    } else if (activation_reason == arAllFramesReady) {
+        const VSFrame *src = vsapi->getFrameFilter(n, d->clip, frame_ctx);
+
+        double difference = getFieldDifference(vsapi, src);
+
+        // Only the properties change, so the planes are shared with src.
+        VSFrame *dst = vsapi->copyFrame(src, core);
+        vsapi->freeFrame(src);
+
+        vsapi->mapSetFloat(vsapi->getFramePropertiesRW(dst), "WibblyFieldDifference", difference, maReplace);
+
+        return dst;
+    }
+
+    return nullptr;
+}
+
+
+static void VS_CC fieldDifferenceFree(void *instance_data, VSCore *, const VSAPI *vsapi) {
+    FieldDifferenceData *d = (FieldDifferenceData *)instance_data;
+
+    vsapi->freeNode(d->clip);
+
+    delete d;
+}
+
+
+VSNode *createFieldDifferenceFilter(const VSAPI *vsapi, VSCore *vscore, VSNode *clip) {
+    const VSVideoInfo *vi = vsapi->getVideoInfo(clip);
+
+    if (vi->format.colorFamily == cfUndefined || !vi->width || !vi->height)
+        throw WobblyException("Can't create the field difference filter: the clip must have constant format and dimensions.");
+
+    if (!((vi->format.sampleType == stInteger && vi->format.bytesPerSample <= 2) || (vi->format.sampleType == stFloat && vi->format.bytesPerSample == 4)))
+        throw WobblyException("Can't create the field difference filter: the clip must have 8..16 bit integer or 32 bit float samples.");
+
+    FieldDifferenceData *d = new FieldDifferenceData{ vsapi->addNodeRef(clip), *vi };
+
+    VSFilterDependency deps[] = { { d->clip, rpStrictSpatial } };
+
+    return vsapi->createVideoFilter2("WibblyFieldDifference", &d->vi, fieldDifferenceGetFrame, fieldDifferenceFree, fmParallel, deps, 1, d, vscore);
+}
+
+
+static void VS_CC fieldDifferenceFunction(const VSMap *in, VSMap *out, void *, VSCore *core, const VSAPI *vsapi) {
+    int err;
+    VSNode *clip = vsapi->mapGetNode(in, "clip", 0, &err);
+    if (err) {
+        vsapi->mapSetError(out, "wibbly_field_difference: argument clip is required.");
+        return;
+    }
+
+    try {
+        vsapi->mapConsumeNode(out, "clip", createFieldDifferenceFilter(vsapi, core, clip), maReplace);
+    } catch (WobblyException &e) {
+        vsapi->mapSetError(out, (std::string("wibbly_field_difference: ") + e.what()).c_str());
+    }
+
+    vsapi->freeNode(clip);
+}
+
+
+VSFunction *createFieldDifferenceFunction(const VSAPI *vsapi, VSCore *vscore) {
+    return vsapi->createFunction(fieldDifferenceFunction, nullptr, nullptr, vscore);
+}
+
+
+VSNode *invokeFilter(const VSAPI *vsapi, VSCore *vscore, const char *plugin_namespace, const char *function_name, VSMap *args) {
+    std::string name = std::string(plugin_namespace) + "." + function_name;
+
+    VSPlugin *plugin = vsapi->getPluginByNamespace(plugin_namespace, vscore);
+    if (!plugin) {
+        vsapi->freeMap(args);
+        throw WobblyException("Can't invoke " + name + ": plugin not found.");
+    }
+
+    VSMap *ret = vsapi->invoke(plugin, function_name, args);
+    vsapi->freeMap(args);
+
+    const char *error = vsapi->mapGetError(ret);
+    if (error) {
+        std::string message = "Can't invoke " + name + ": " + error;
+        vsapi->freeMap(ret);
+        throw WobblyException(message);
+    }
+
+    VSNode *node = vsapi->mapGetNode(ret, "clip", 0, nullptr);
+    vsapi->freeMap(ret);
+
+    return node;
+}
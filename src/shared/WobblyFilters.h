@@ -0,0 +1,80 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef WOBBLYFILTERS_H
+#define WOBBLYFILTERS_H
+
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+#include <VapourSynth4.h>
+
+#include "RowKernels.h"
+#include "WobblyTypes.h"
+
+
+// Matches and freeze frames as seen by the main display's native filter.
+// WobblyProject owns it and updates it after every edit, while the
+// VapourSynth worker threads read from it.
+class FrameOverrides {
+    mutable std::shared_mutex mutex;
+
+    std::vector<char> matches;
+    std::vector<FreezeFrame> freeze_frames; // Sorted by FreezeFrame::first.
+    bool tff = true;
+
+public:
+    // Returns false if nothing changed. Otherwise, the output frames from
+    // first_changed to last_changed may look different now, and the rest
+    // don't. last_changed can be INT_MAX.
+    bool update(const char *new_matches, size_t num_matches, const FreezeFrameMap &new_freeze_frames, bool freeze_frames_wanted, bool new_tff, int *first_changed, int *last_changed);
+
+    // Finds the frames whose top and bottom fields make up output frame n.
+    // frame receives the frame whose properties are passed through.
+    void getFieldSources(int n, int num_frames, int *frame, int *top, int *bottom) const;
+};
+
+
+// Replaces FieldHint and FreezeFrames in the main display script.
+// The returned node does not consume clip.
+VSNode *createOverridesFilter(const VSAPI *vsapi, VSCore *vscore, VSNode *clip, const std::shared_ptr<FrameOverrides> &overrides);
+
+// Sets WibblyFieldDifference, the absolute difference between the average
+// luma of the top and the bottom field of each frame, normalised like
+// std.PlaneStats. The returned node does not consume clip.
+VSNode *createFieldDifferenceFilter(const VSAPI *vsapi, VSCore *vscore, VSNode *clip);
+
+// Adds up the width bytes of one row, for createFieldDifferenceFilter.
+typedef uint64_t (*SumRowFunc)(const uint8_t *row, int width);
+
+typedef RowKernel<SumRowFunc> SumRowKernel;
+
+// The filter uses the last one. Only the benchmark needs them.
+std::vector<SumRowKernel> getSumRowKernels();
+
+// The same filter as a function for scripts, taking a clip and returning
+// the new clip as "clip".
+VSFunction *createFieldDifferenceFunction(const VSAPI *vsapi, VSCore *vscore);
+
+// Calls a plugin function that returns a clip. Always frees args.
+VSNode *invokeFilter(const VSAPI *vsapi, VSCore *vscore, const char *plugin_namespace, const char *function_name, VSMap *args);
+
+#endif // WOBBLYFILTERS_H
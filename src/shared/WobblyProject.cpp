@@ -19,6 +19,8 @@ SOFTWARE.
 */
 
 
+#include <algorithm>
+#include <bit>
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
@@ -29,20 +31,30 @@ SOFTWARE.
 #include <unordered_set>
 #include <vector>
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 
 #define RAPIDJSON_NAMESPACE rj
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "rapidjson/document.h"
 #include "rapidjson/prettywriter.h"
+#include "rapidjson/reader.h"
 #include "rapidjson/error/en.h"
 
 #include "RandomStuff.h"
 #include "WobblyException.h"
+#include "WobblyFilters.h"
 #include "WobblyProject.h"
 
 
-#define PROJECT_FORMAT_VERSION 3
+#define PROJECT_FORMAT_VERSION 4
+// Projects without a columns file don't need anything newer than version 3.
+#define PROJECT_FORMAT_VERSION_INLINE_COLUMNS 3
+
+#define COLUMNS_FILE_VERSION 1
+#define COLUMNS_FILE_ALIGNMENT 64
 
 
 namespace Keys {
@@ -111,6 +123,7 @@ namespace Keys {
     const char combed_frames[] = "combed" " " "frames";;
     const char decimated_frames[] = "decimated" " " "frames";;
     const char decimate_metrics[] = "decimate" " " "metrics";;
+    const char columns_file[] = "columns" " " "file";;
     const char sections[] = "sections";;
     namespace Sections {
         const char start[] = "start";;
@@ -167,6 +180,7 @@ WobblyProject::WobblyProject(bool _is_wobbly)
     , custom_lists(new CustomListsModel(this))
     , sections(new SectionsModel(this))
     , bookmarks(new BookmarksModel(this))
+    , frame_overrides(std::make_shared<FrameOverrides>())
 {
     connect(bookmarks, &BookmarksModel::dataChanged, [this] () {
         setModified(true);
@@ -188,7 +202,7 @@ WobblyProject::WobblyProject(bool _is_wobbly, const std::string &_input_file, co
 
     // XXX What happens when the video happens to be bottom field first?
     vfm_parameters_int.insert({ "order", 1 });
-    decimated_frames.resize((_num_frames - 1) / 5 + 1);
+    resetDecimatedFrames();
     addSection(0);
     resize.width = _width;
     resize.height = _height;
@@ -222,56 +236,109 @@ void WobblyProject::setNumFrames(PositionInFilterChain position, int frames) {
 }
 
 
-void WobblyProject::writeProject(const std::string &path, bool compact_project) {
-    QFile file(QString::fromStdString(path));
+// Buffers the writer's output and passes it to a QIODevice in big chunks.
+class QIODeviceWriteStream {
+public:
+    typedef char Ch;
 
-    if (!file.open(QIODevice::WriteOnly))
-        throw WobblyException("Couldn't open project file '" + path + "'. Error message: " + file.errorString().toStdString());
+    QIODeviceWriteStream(QIODevice &_device)
+        : device(_device)
+    { }
+
+    ~QIODeviceWriteStream() {
+        Flush();
+    }
 
-    rj::Document json_project(rj::kObjectType);
+    void Put(Ch c) {
+        if (used == sizeof(buffer))
+            Flush();
+        buffer[used++] = c;
+    }
 
-    rj::Document::AllocatorType &a = json_project.GetAllocator();
+    void Flush() {
+        if (used && device.write(buffer, used) != (qint64)used)
+            failed = true;
+        used = 0;
+    }
 
-    json_project.AddMember(Keys::wobbly_version, std::atoi(PACKAGE_VERSION), a);
+    bool hasFailed() const {
+        return failed;
+    }
 
+    // Not implemented.
+    Ch Peek() const { RAPIDJSON_ASSERT(false); return 0; }
+    Ch Take() { RAPIDJSON_ASSERT(false); return 0; }
+    size_t Tell() const { RAPIDJSON_ASSERT(false); return 0; }
+    Ch *PutBegin() { RAPIDJSON_ASSERT(false); return nullptr; }
+    size_t PutEnd(Ch *) { RAPIDJSON_ASSERT(false); return 0; }
 
-    json_project.AddMember(Keys::project_format_version, PROJECT_FORMAT_VERSION, a);
+private:
+    QIODevice &device;
+    char buffer[65536];
+    size_t used = 0;
+    bool failed = false;
+};
 
 
-    json_project.AddMember(Keys::input_file, input_file, a);
+template <typename JsonWriter>
+void WobblyProject::writeJson(JsonWriter &w, const std::string &columns_file) const {
+    w.StartObject();
 
+    w.Key(Keys::wobbly_version);
+    w.Int(std::atoi(PACKAGE_VERSION));
 
-    rj::Value json_fps(rj::kArrayType);
-    json_fps.PushBack(fps_num, a);
-    json_fps.PushBack(fps_den, a);
-    json_project.AddMember(Keys::input_frame_rate, json_fps, a);
 
+    w.Key(Keys::project_format_version);
+    w.Int(columns_file.size() ? PROJECT_FORMAT_VERSION : PROJECT_FORMAT_VERSION_INLINE_COLUMNS);
 
-    rj::Value json_resolution(rj::kArrayType);
-    json_resolution.PushBack(width, a);
-    json_resolution.PushBack(height, a);
-    json_project.AddMember(Keys::input_resolution, json_resolution, a);
 
+    w.Key(Keys::input_file);
+    w.String(input_file);
 
-    if (is_wobbly) {
-        rj::Value json_ui(rj::kObjectType);
-        json_ui.AddMember(Keys::UserInterface::zoom, zoom, a);
-        json_ui.AddMember(Keys::UserInterface::last_visited_frame, last_visited_frame, a);
-        json_ui.AddMember(Keys::UserInterface::geometry, ui_geometry, a);
-        json_ui.AddMember(Keys::UserInterface::state, ui_state, a);
 
-        rj::Value json_rates(rj::kArrayType);
+    w.Key(Keys::input_frame_rate);
+    w.StartArray();
+    w.Int64(fps_num);
+    w.Int64(fps_den);
+    w.EndArray();
+
+
+    w.Key(Keys::input_resolution);
+    w.StartArray();
+    w.Int(width);
+    w.Int(height);
+    w.EndArray();
+
+
+    if (is_wobbly) {
+        w.Key(Keys::user_interface);
+        w.StartObject();
+
+        w.Key(Keys::UserInterface::zoom);
+        w.Int(zoom);
+        w.Key(Keys::UserInterface::last_visited_frame);
+        w.Int(last_visited_frame);
+        w.Key(Keys::UserInterface::geometry);
+        w.String(ui_geometry);
+        w.Key(Keys::UserInterface::state);
+        w.String(ui_state);
+
+        w.Key(Keys::UserInterface::show_frame_rates);
+        w.StartArray();
         int rates[] = { 30, 24, 18, 12, 6 };
         for (int i = 0; i < 5; i++)
             if (shown_frame_rates[i])
-                json_rates.PushBack(rates[i], a);
-        json_ui.AddMember(Keys::UserInterface::show_frame_rates, json_rates, a);
+                w.Int(rates[i]);
+        w.EndArray();
 
-        json_ui.AddMember(Keys::UserInterface::mic_search_minimum, mic_search_minimum, a);
-        json_ui.AddMember(Keys::UserInterface::c_match_sequences_minimum, c_match_sequences_minimum, a);
+        w.Key(Keys::UserInterface::mic_search_minimum);
+        w.Int(mic_search_minimum);
+        w.Key(Keys::UserInterface::c_match_sequences_minimum);
+        w.Int(c_match_sequences_minimum);
 
         if (pattern_guessing.failures.size()) {
-            rj::Value json_pattern_guessing(rj::kObjectType);
+            w.Key(Keys::UserInterface::pattern_guessing);
+            w.StartObject();
 
             const char *guessing_methods[] = {
                 "from matches",
@@ -279,16 +346,19 @@ void WobblyProject::writeProject(const std::string &path, bool compact_project)
                 "from dmetrics",
                 "from mics+dmetrics",
             };
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::method, rj::Value(guessing_methods[pattern_guessing.method], a), a);
+            w.Key(Keys::UserInterface::PatternGuessing::method);
+            w.String(guessing_methods[pattern_guessing.method]);
 
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::minimum_length, pattern_guessing.minimum_length, a);
+            w.Key(Keys::UserInterface::PatternGuessing::minimum_length);
+            w.Int(pattern_guessing.minimum_length);
 
             const char *third_n_match[] = {
                 "always",
                 "never",
                 "if it has lower mic"
             };
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::use_third_n_match, rj::Value(third_n_match[pattern_guessing.third_n_match], a), a);
+            w.Key(Keys::UserInterface::PatternGuessing::use_third_n_match);
+            w.String(third_n_match[pattern_guessing.third_n_match]);
 
             const char *decimate[] = {
                 "first duplicate",
@@ -296,9 +366,8 @@ void WobblyProject::writeProject(const std::string &path, bool compact_project)
                 "duplicate with higher mic per cycle",
                 "duplicate with higher mic per section"
             };
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::decimate, rj::Value(decimate[pattern_guessing.decimation], a), a);
-
-            rj::Value json_use_patterns(rj::kArrayType);
+            w.Key(Keys::UserInterface::PatternGuessing::decimate);
+            w.String(decimate[pattern_guessing.decimation]);
 
             std::map<int, std::string> use_patterns = {
                 { PatternCCCNN, "cccnn" },
@@ -306,227 +375,272 @@ void WobblyProject::writeProject(const std::string &path, bool compact_project)
                 { PatternCCCCC, "ccccc" }
             };
 
+            w.Key(Keys::UserInterface::PatternGuessing::use_patterns);
+            w.StartArray();
             for (auto it = use_patterns.cbegin(); it != use_patterns.cend(); it++)
                 if (pattern_guessing.use_patterns & it->first)
-                    json_use_patterns.PushBack(rj::Value(it->second, a), a);
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::use_patterns, json_use_patterns, a);
-
-            rj::Value json_failures(rj::kArrayType);
+                    w.String(it->second);
+            w.EndArray();
 
             const char *reasons[] = {
                 "section too short",
                 "ambiguous pattern"
             };
+
+            w.Key(Keys::UserInterface::PatternGuessing::failures);
+            w.StartArray();
             for (auto it = pattern_guessing.failures.cbegin(); it != pattern_guessing.failures.cend(); it++) {
-                rj::Value json_failure(rj::kObjectType);
-                json_failure.AddMember(Keys::UserInterface::PatternGuessing::Failures::start, it->second.start, a);
-                json_failure.AddMember(Keys::UserInterface::PatternGuessing::Failures::reason, rj::Value(reasons[it->second.reason], a), a);
-                json_failures.PushBack(json_failure, a);
+                w.StartObject();
+                w.Key(Keys::UserInterface::PatternGuessing::Failures::start);
+                w.Int(it->second.start);
+                w.Key(Keys::UserInterface::PatternGuessing::Failures::reason);
+                w.String(reasons[it->second.reason]);
+                w.EndObject();
             }
-            json_pattern_guessing.AddMember(Keys::UserInterface::PatternGuessing::failures, json_failures, a);
+            w.EndArray();
 
-            json_ui.AddMember(Keys::UserInterface::pattern_guessing, json_pattern_guessing, a);
+            w.EndObject();
         }
 
         if (bookmarks->size()) {
-            rj::Value json_bookmarks(rj::kArrayType);
+            w.Key(Keys::UserInterface::bookmarks);
+            w.StartArray();
 
             for (auto it = bookmarks->cbegin(); it != bookmarks->cend(); it++) {
-                rj::Value json_bookmark(rj::kObjectType);
-                json_bookmark.AddMember(Keys::UserInterface::Bookmarks::frame, it->second.frame, a);
-                json_bookmark.AddMember(Keys::UserInterface::Bookmarks::description, rj::Value(it->second.description, a), a);
-                json_bookmarks.PushBack(json_bookmark, a);
+                w.StartObject();
+                w.Key(Keys::UserInterface::Bookmarks::frame);
+                w.Int(it->second.frame);
+                w.Key(Keys::UserInterface::Bookmarks::description);
+                w.String(it->second.description);
+                w.EndObject();
             }
 
-            json_ui.AddMember(Keys::UserInterface::bookmarks, json_bookmarks, a);
+            w.EndArray();
         }
 
-        json_project.AddMember(Keys::user_interface, json_ui, a);
+        w.EndObject();
     }
 
 
-    rj::Value json_trims(rj::kArrayType);
+    w.Key(Keys::trim);
+    w.StartArray();
 
     for (auto it = trims.cbegin(); it != trims.cend(); it++) {
-        rj::Value json_trim(rj::kArrayType);
-        json_trim.PushBack(it->second.first, a);
-        json_trim.PushBack(it->second.last, a);
-        json_trims.PushBack(json_trim, a);
+        w.StartArray();
+        w.Int(it->second.first);
+        w.Int(it->second.last);
+        w.EndArray();
     }
-    json_project.AddMember(Keys::trim, json_trims, a);
+
+    w.EndArray();
 
     // FIXME, should probably save/load the DMetrics parameters here as well
-    rj::Value json_vfm_parameters(rj::kObjectType);
+    w.Key(Keys::vfm_parameters);
+    w.StartObject();
+
+    for (auto it = vfm_parameters_int.cbegin(); it != vfm_parameters_int.cend(); it++) {
+        w.Key(it->first);
+        w.Int(it->second);
+    }
 
-    for (auto it = vfm_parameters_int.cbegin(); it != vfm_parameters_int.cend(); it++)
-        json_vfm_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    for (auto it = vfm_parameters_double.cbegin(); it != vfm_parameters_double.cend(); it++) {
+        w.Key(it->first);
+        w.Double(it->second);
+    }
 
-    for (auto it = vfm_parameters_double.cbegin(); it != vfm_parameters_double.cend(); it++)
-        json_vfm_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    for (auto it = vfm_parameters_bool.cbegin(); it != vfm_parameters_bool.cend(); it++) {
+        w.Key(it->first);
+        w.Bool(it->second);
+    }
 
-    for (auto it = vfm_parameters_bool.cbegin(); it != vfm_parameters_bool.cend(); it++)
-        json_vfm_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    w.EndObject();
 
-    json_project.AddMember(Keys::vfm_parameters, json_vfm_parameters, a);
 
+    w.Key(Keys::vdecimate_parameters);
+    w.StartObject();
 
-    rj::Value json_vdecimate_parameters(rj::kObjectType);
+    for (auto it = vdecimate_parameters_int.cbegin(); it != vdecimate_parameters_int.cend(); it++) {
+        w.Key(it->first);
+        w.Int(it->second);
+    }
 
-    for (auto it = vdecimate_parameters_int.cbegin(); it != vdecimate_parameters_int.cend(); it++)
-        json_vdecimate_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    for (auto it = vdecimate_parameters_double.cbegin(); it != vdecimate_parameters_double.cend(); it++) {
+        w.Key(it->first);
+        w.Double(it->second);
+    }
 
-    for (auto it = vdecimate_parameters_double.cbegin(); it != vdecimate_parameters_double.cend(); it++)
-        json_vdecimate_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    for (auto it = vdecimate_parameters_bool.cbegin(); it != vdecimate_parameters_bool.cend(); it++) {
+        w.Key(it->first);
+        w.Bool(it->second);
+    }
 
-    for (auto it = vdecimate_parameters_bool.cbegin(); it != vdecimate_parameters_bool.cend(); it++)
-        json_vdecimate_parameters.AddMember(rj::Value(it->first, a), rj::Value(it->second), a);
+    w.EndObject();
 
-    json_project.AddMember(Keys::vdecimate_parameters, json_vdecimate_parameters, a);
+    if (columns_file.size()) {
+        w.Key(Keys::columns_file);
+        w.String(columns_file);
+    }
 
-    if (mics.size()) {
-        rj::Value json_mics(rj::kArrayType);
+    if (mics.size() && columns_file.empty()) {
+        w.Key(Keys::mics);
+        w.StartArray();
 
         for (size_t i = 0; i < mics.size(); i++) {
-            rj::Value json_mic(rj::kArrayType);
+            w.StartArray();
             for (int j = 0; j < 5; j++)
-                json_mic.PushBack(mics[i][j], a);
-            json_mics.PushBack(json_mic, a);
+                w.Int(mics[i][j]);
+            w.EndArray();
         }
 
-        json_project.AddMember(Keys::mics, json_mics, a);
+        w.EndArray();
     }
 
-    if (mmetrics.size()) {
-        rj::Value json_mmetrics(rj::kArrayType);
+    if (mmetrics.size() && columns_file.empty()) {
+        w.Key(Keys::mmetrics);
+        w.StartArray();
 
         for (size_t i = 0; i < mmetrics.size(); i++) {
-            rj::Value json_mmetric(rj::kArrayType);
+            w.StartArray();
             for (int j = 0; j < 2; j++)
-                json_mmetric.PushBack(mmetrics[i][j], a);
-            json_mmetrics.PushBack(json_mmetric, a);
+                w.Int(mmetrics[i][j]);
+            w.EndArray();
         }
 
-        json_project.AddMember(Keys::mmetrics, json_mmetrics, a);
+        w.EndArray();
     }
 
-    if (vmetrics.size()) {
-        rj::Value json_vmetrics(rj::kArrayType);
+    if (vmetrics.size() && columns_file.empty()) {
+        w.Key(Keys::vmetrics);
+        w.StartArray();
 
         for (size_t i = 0; i < vmetrics.size(); i++) {
-            rj::Value json_vmetric(rj::kArrayType);
+            w.StartArray();
             for (int j = 0; j < 2; j++)
-                json_vmetric.PushBack(vmetrics[i][j], a);
-            json_vmetrics.PushBack(json_vmetric, a);
+                w.Int(vmetrics[i][j]);
+            w.EndArray();
         }
 
-        json_project.AddMember(Keys::vmetrics, json_vmetrics, a);
+        w.EndArray();
     }
 
-    if (matches.size()) {
-        rj::Value json_matches(rj::kArrayType);
+    if (matches.size() && columns_file.empty()) {
+        w.Key(Keys::matches);
+        w.StartArray();
 
         for (size_t i = 0; i < matches.size(); i++)
-            json_matches.PushBack(rj::Value(&matches[i], 1), a);
+            w.String(&matches[i], 1);
 
-        json_project.AddMember(Keys::matches, json_matches, a);
+        w.EndArray();
     }
 
-    if (original_matches.size()) {
-        rj::Value json_original_matches(rj::kArrayType);
+    if (original_matches.size() && columns_file.empty()) {
+        w.Key(Keys::original_matches);
+        w.StartArray();
 
         for (size_t i = 0; i < original_matches.size(); i++)
-            json_original_matches.PushBack(rj::Value(&original_matches[i], 1), a);
+            w.String(&original_matches[i], 1);
 
-        json_project.AddMember(Keys::original_matches, json_original_matches, a);
+        w.EndArray();
     }
 
     if (combed_frames->cbegin() != combed_frames->cend()) {
-        rj::Value json_combed_frames(rj::kArrayType);
+        w.Key(Keys::combed_frames);
+        w.StartArray();
 
         for (auto it = combed_frames->cbegin(); it != combed_frames->cend(); it++)
-            json_combed_frames.PushBack(*it, a);
+            w.Int(*it);
 
-        json_project.AddMember(Keys::combed_frames, json_combed_frames, a);
+        w.EndArray();
     }
 
     if (decimated_frames.size()) {
-        rj::Value json_decimated_frames(rj::kArrayType);
+        w.Key(Keys::decimated_frames);
+        w.StartArray();
 
         for (size_t i = 0; i < decimated_frames.size(); i++)
-            for (auto it = decimated_frames[i].cbegin(); it != decimated_frames[i].cend(); it++)
-                json_decimated_frames.PushBack((int)i * 5 + *it, a);
+            for (int j = 0; j < 5; j++)
+                if (decimated_frames[i] & (1 << j))
+                    w.Int((int)i * 5 + j);
 
-        json_project.AddMember(Keys::decimated_frames, json_decimated_frames, a);
+        w.EndArray();
     }
 
-    if (decimate_metrics.size()) {
-        rj::Value json_decimate_metrics(rj::kArrayType);
+    if (decimate_metrics.size() && columns_file.empty()) {
+        w.Key(Keys::decimate_metrics);
+        w.StartArray();
 
         for (size_t i = 0; i < decimate_metrics.size(); i++)
-            json_decimate_metrics.PushBack(getDecimateMetric(i), a);
+            w.Int(getDecimateMetric(i));
 
-        json_project.AddMember(Keys::decimate_metrics, json_decimate_metrics, a);
+        w.EndArray();
     }
 
 
-    rj::Value json_sections(rj::kArrayType);
+    w.Key(Keys::sections);
+    w.StartArray();
 
     for (auto it = sections->cbegin(); it != sections->cend(); it++) {
-        rj::Value json_section(rj::kObjectType);
-        json_section.AddMember(Keys::Sections::start, it->second.start, a);
-        rj::Value json_presets(rj::kArrayType);
+        w.StartObject();
+        w.Key(Keys::Sections::start);
+        w.Int(it->second.start);
+        w.Key(Keys::Sections::presets);
+        w.StartArray();
         for (size_t i = 0; i < it->second.presets.size(); i++)
-            json_presets.PushBack(rj::Value(it->second.presets[i], a), a);
-        json_section.AddMember(Keys::Sections::presets, json_presets, a);
-
-        json_sections.PushBack(json_section, a);
+            w.String(it->second.presets[i]);
+        w.EndArray();
+        w.EndObject();
     }
 
-    json_project.AddMember(Keys::sections, json_sections, a);
+    w.EndArray();
 
 
-    json_project.AddMember(Keys::source_filter, source_filter, a);
+    w.Key(Keys::source_filter);
+    w.String(source_filter);
 
 
-    rj::Value json_interlaced_fades(rj::kArrayType);
+    w.Key(Keys::interlaced_fades);
+    w.StartArray();
 
     for (auto it = interlaced_fades.cbegin(); it != interlaced_fades.cend(); it++) {
-        rj::Value json_interlaced_fade(rj::kObjectType);
-        json_interlaced_fade.AddMember(Keys::InterlacedFades::frame, it->second.frame, a);
-        json_interlaced_fade.AddMember(Keys::InterlacedFades::field_difference, it->second.field_difference, a);
-
-        json_interlaced_fades.PushBack(json_interlaced_fade, a);
+        w.StartObject();
+        w.Key(Keys::InterlacedFades::frame);
+        w.Int(it->second.frame);
+        w.Key(Keys::InterlacedFades::field_difference);
+        w.Double(it->second.field_difference);
+        w.EndObject();
     }
 
-    json_project.AddMember(Keys::interlaced_fades, json_interlaced_fades, a);
+    w.EndArray();
 
 
     if (is_wobbly) {
-        rj::Value json_presets(rj::kArrayType);
-        rj::Value json_frozen_frames(rj::kArrayType);
+        w.Key(Keys::presets);
+        w.StartArray();
 
         for (auto it = presets->cbegin(); it != presets->cend(); it++) {
-            rj::Value json_preset(rj::kObjectType);
-            json_preset.AddMember(Keys::Presets::name, it->second.name, a);
-            json_preset.AddMember(Keys::Presets::contents, it->second.contents, a);
-
-            json_presets.PushBack(json_preset, a);
+            w.StartObject();
+            w.Key(Keys::Presets::name);
+            w.String(it->second.name);
+            w.Key(Keys::Presets::contents);
+            w.String(it->second.contents);
+            w.EndObject();
         }
 
-        for (auto it = frozen_frames->cbegin(); it != frozen_frames->cend(); it++) {
-            rj::Value json_ff(rj::kArrayType);
-            json_ff.PushBack(it->second.first, a);
-            json_ff.PushBack(it->second.last, a);
-            json_ff.PushBack(it->second.replacement, a);
+        w.EndArray();
 
-            json_frozen_frames.PushBack(json_ff, a);
-        }
+        w.Key(Keys::frozen_frames);
+        w.StartArray();
 
-        json_project.AddMember(Keys::presets, json_presets, a);
-        json_project.AddMember(Keys::frozen_frames, json_frozen_frames, a);
+        for (auto it = frozen_frames->cbegin(); it != frozen_frames->cend(); it++) {
+            w.StartArray();
+            w.Int(it->second.first);
+            w.Int(it->second.last);
+            w.Int(it->second.replacement);
+            w.EndArray();
+        }
 
+        w.EndArray();
 
-        rj::Value json_custom_lists(rj::kArrayType);
 
         const char *list_positions[] = {
             "post source",
@@ -534,83 +648,731 @@ void WobblyProject::writeProject(const std::string &path, bool compact_project)
             "post decimate"
         };
 
+        w.Key(Keys::custom_lists);
+        w.StartArray();
+
         for (size_t i = 0; i < custom_lists->size(); i++) {
             const CustomList &cl = custom_lists->at(i);
 
-            rj::Value json_custom_list(rj::kObjectType);
-            json_custom_list.AddMember(Keys::CustomLists::name, cl.name, a);
-            json_custom_list.AddMember(Keys::CustomLists::preset, cl.preset, a);
-            json_custom_list.AddMember(Keys::CustomLists::position, rj::Value(list_positions[cl.position], a), a);
-            rj::Value json_frames(rj::kArrayType);
+            w.StartObject();
+            w.Key(Keys::CustomLists::name);
+            w.String(cl.name);
+            w.Key(Keys::CustomLists::preset);
+            w.String(cl.preset);
+            w.Key(Keys::CustomLists::position);
+            w.String(list_positions[cl.position]);
+            w.Key(Keys::CustomLists::frames);
+            w.StartArray();
             for (auto it = cl.ranges->cbegin(); it != cl.ranges->cend(); it++) {
-                rj::Value json_pair(rj::kArrayType);
-                json_pair.PushBack(it->second.first, a);
-                json_pair.PushBack(it->second.last, a);
-                json_frames.PushBack(json_pair, a);
+                w.StartArray();
+                w.Int(it->second.first);
+                w.Int(it->second.last);
+                w.EndArray();
             }
-            json_custom_list.AddMember(Keys::CustomLists::frames, json_frames, a);
-
-            json_custom_lists.PushBack(json_custom_list, a);
+            w.EndArray();
+            w.EndObject();
         }
 
-        json_project.AddMember(Keys::custom_lists, json_custom_lists, a);
+        w.EndArray();
 
 
         if (resize.enabled) {
-            rj::Value json_resize(rj::kObjectType);
-            json_resize.AddMember(Keys::Resize::width, resize.width, a);
-            json_resize.AddMember(Keys::Resize::height, resize.height, a);
-            json_resize.AddMember(Keys::Resize::filter, resize.filter, a);
-            json_project.AddMember(Keys::resize, json_resize, a);
+            w.Key(Keys::resize);
+            w.StartObject();
+            w.Key(Keys::Resize::width);
+            w.Int(resize.width);
+            w.Key(Keys::Resize::height);
+            w.Int(resize.height);
+            w.Key(Keys::Resize::filter);
+            w.String(resize.filter);
+            w.EndObject();
         }
 
         if (crop.enabled) {
-            rj::Value json_crop(rj::kObjectType);
-            json_crop.AddMember(Keys::Crop::early, crop.early, a);
-            json_crop.AddMember(Keys::Crop::left, crop.left, a);
-            json_crop.AddMember(Keys::Crop::top, crop.top, a);
-            json_crop.AddMember(Keys::Crop::right, crop.right, a);
-            json_crop.AddMember(Keys::Crop::bottom, crop.bottom, a);
-            json_project.AddMember(Keys::crop, json_crop, a);
+            w.Key(Keys::crop);
+            w.StartObject();
+            w.Key(Keys::Crop::early);
+            w.Bool(crop.early);
+            w.Key(Keys::Crop::left);
+            w.Int(crop.left);
+            w.Key(Keys::Crop::top);
+            w.Int(crop.top);
+            w.Key(Keys::Crop::right);
+            w.Int(crop.right);
+            w.Key(Keys::Crop::bottom);
+            w.Int(crop.bottom);
+            w.EndObject();
         }
 
         if (depth.enabled) {
-            rj::Value json_depth(rj::kObjectType);
-            json_depth.AddMember(Keys::Depth::bits, depth.bits, a);
-            json_depth.AddMember(Keys::Depth::float_samples, depth.float_samples, a);
-            json_depth.AddMember(Keys::Depth::dither, depth.dither, a);
-            json_project.AddMember(Keys::depth, json_depth, a);
+            w.Key(Keys::depth);
+            w.StartObject();
+            w.Key(Keys::Depth::bits);
+            w.Int(depth.bits);
+            w.Key(Keys::Depth::float_samples);
+            w.Bool(depth.float_samples);
+            w.Key(Keys::Depth::dither);
+            w.String(depth.dither);
+            w.EndObject();
         }
     }
 
-    rj::StringBuffer buffer;
+    w.EndObject();
+}
 
-    if (compact_project) {
-        rj::Writer<rj::StringBuffer> writer(buffer);
-        json_project.Accept(writer);
-    } else {
-        rj::PrettyWriter<rj::StringBuffer> writer(buffer);
-        json_project.Accept(writer);
+
+// The columns file holds the per-frame arrays of a project as raw values
+// in the machine's byte order, so that they can be mapped instead of parsed.
+// It starts with a ColumnsFileHeader, followed by num_columns
+// ColumnsFileEntry structs. Every column's data begins at an offset that
+// is a multiple of COLUMNS_FILE_ALIGNMENT.
+struct ColumnsFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t num_columns;
+    uint32_t reserved;
+};
+
+
+struct ColumnsFileEntry {
+    char name[24]; // The column's JSON key. Not terminated if it fills the array.
+    uint32_t element_size;
+    uint32_t num_elements;
+    uint64_t offset;
+};
+
+
+static const char columns_file_magic[8] = { 'W', 'O', 'B', 'C', 'O', 'L', 'S', 0 };
+static const uint32_t columns_file_byte_order = 0x01020304;
+
+
+static uint64_t alignColumnOffset(uint64_t offset) {
+    return (offset + COLUMNS_FILE_ALIGNMENT - 1) / COLUMNS_FILE_ALIGNMENT * COLUMNS_FILE_ALIGNMENT;
+}
+
+
+void WobblyProject::writeColumnsFile(const std::string &path) const {
+    struct Column {
+        const char *name;
+        const char *data;
+        size_t element_size;
+        size_t num_elements;
+    };
+
+    std::vector<Column> columns;
+
+    auto addColumn = [&columns] (const char *name, const auto &column) {
+        if (column.size())
+            columns.push_back({ name, (const char *)column.data(), sizeof(column[0]), column.size() });
+    };
+
+    addColumn(Keys::mics, mics);
+    addColumn(Keys::mmetrics, mmetrics);
+    addColumn(Keys::vmetrics, vmetrics);
+    addColumn(Keys::matches, matches);
+    addColumn(Keys::original_matches, original_matches);
+    addColumn(Keys::decimate_metrics, decimate_metrics);
+
+    ColumnsFileHeader header = {};
+    memcpy(header.magic, columns_file_magic, sizeof(header.magic));
+    header.version = COLUMNS_FILE_VERSION;
+    header.byte_order = columns_file_byte_order;
+    header.num_columns = columns.size();
+
+    std::vector<ColumnsFileEntry> entries(columns.size());
+
+    uint64_t offset = alignColumnOffset(sizeof(ColumnsFileHeader) + entries.size() * sizeof(ColumnsFileEntry));
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        memcpy(entries[i].name, columns[i].name, std::min(strlen(columns[i].name), sizeof(entries[i].name)));
+        entries[i].element_size = columns[i].element_size;
+        entries[i].num_elements = columns[i].num_elements;
+        entries[i].offset = offset;
+
+        offset = alignColumnOffset(offset + columns[i].element_size * columns[i].num_elements);
+    }
+
+    QSaveFile file(QString::fromStdString(path));
+
+    if (!file.open(QIODevice::WriteOnly))
+        throw WobblyException("Couldn't open columns file '" + path + "'. Error message: " + file.errorString().toStdString());
+
+    auto writeData = [&file] (const char *data, uint64_t size) {
+        return file.write(data, size) == (qint64)size;
+    };
+
+    static const char padding[COLUMNS_FILE_ALIGNMENT] = { 0 };
+
+    bool ok = writeData((const char *)&header, sizeof(header)) &&
+              writeData((const char *)entries.data(), entries.size() * sizeof(ColumnsFileEntry));
+
+    uint64_t position = sizeof(ColumnsFileHeader) + entries.size() * sizeof(ColumnsFileEntry);
+
+    for (size_t i = 0; i < columns.size() && ok; i++) {
+        uint64_t size = columns[i].element_size * columns[i].num_elements;
+
+        ok = writeData(padding, entries[i].offset - position) &&
+             writeData(columns[i].data, size);
+
+        position = entries[i].offset + size;
+    }
+
+    if (!ok || !file.commit())
+        throw WobblyException("Couldn't write the columns to file '" + path + "'. Error message: " + file.errorString().toStdString());
+}
+
+
+bool WobblyProject::removeColumnsFile(const std::string &path) {
+    if (QFile::remove(QString::fromStdString(path)) || !QFileInfo::exists(QString::fromStdString(path)))
+        return true;
+
+    // Some systems don't allow deleting a file that is still mapped.
+    if (path != mapped_columns_file)
+        return false;
+
+    detachColumns();
+    mapped_columns_file.clear();
+
+    return QFile::remove(QString::fromStdString(path));
+}
+
+
+void WobblyProject::writeProject(const std::string &path, bool compact_project, bool binary_columns) {
+    QFileInfo info(QString::fromStdString(path));
+    QDir dir = info.dir();
+
+    // Stored relative to the project, so the two files can be moved together.
+    std::string columns_file;
+
+    if (binary_columns) {
+        // A name no file has yet, so the project on disk keeps its columns
+        // if anything below fails, and no other project loses its own.
+        std::string prefix = info.fileName().toStdString() + ".";
+
+        for (int number = 1; columns_file.empty() || dir.exists(QString::fromStdString(columns_file)); number++)
+            columns_file = prefix + std::to_string(number) + ".columns";
+
+        writeColumnsFile(dir.filePath(QString::fromStdString(columns_file)).toStdString());
+    }
+
+    auto discardColumnsFile = [&] () {
+        if (binary_columns)
+            dir.remove(QString::fromStdString(columns_file));
+    };
+
+    // QSaveFile writes to a temporary file and renames it over the old project only when everything went well.
+    QSaveFile file(QString::fromStdString(path));
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        discardColumnsFile();
+
+        throw WobblyException("Couldn't open project file '" + path + "'. Error message: " + file.errorString().toStdString());
+    }
+
+    bool failed;
+
+    {
+        QIODeviceWriteStream stream(file);
+
+        if (compact_project) {
+            rj::Writer<QIODeviceWriteStream> writer(stream);
+            writeJson(writer, columns_file);
+        } else {
+            rj::PrettyWriter<QIODeviceWriteStream> writer(stream);
+            writeJson(writer, columns_file);
+        }
+
+        stream.Flush();
+        failed = stream.hasFailed();
     }
 
-    if (file.write(buffer.GetString(), buffer.GetSize()) < 0)
+    if (failed || !file.commit()) {
+        discardColumnsFile();
+
         throw WobblyException("Couldn't write the project to file '" + path + "'. Error message: " + file.errorString().toStdString());
+    }
+
+    std::string old_columns_file;
+
+    // Only the project file just replaced is known to refer to its columns
+    // file. Backups and copies of the project may refer to others.
+    if (info.absoluteFilePath().toStdString() == project_file)
+        old_columns_file = project_columns_file;
+
+    project_file = info.absoluteFilePath().toStdString();
+    project_columns_file = binary_columns ? dir.absoluteFilePath(QString::fromStdString(columns_file)).toStdString() : "";
+    obsolete_columns_file.clear();
+
+    if (old_columns_file.size() && old_columns_file != project_columns_file && !removeColumnsFile(old_columns_file))
+        obsolete_columns_file = old_columns_file;
 
     setModified(false);
 }
 
 
+// Reads a QFile in chunks, so the whole project never has to be in memory at once.
+class QFileReadStream {
+public:
+    typedef char Ch;
+
+    QFileReadStream(QFile &_file)
+        : file(_file)
+        , current(buffer)
+    {
+        read();
+    }
+
+    Ch Peek() const { return *current; }
+    Ch Take() { Ch c = *current; read(); return c; }
+    size_t Tell() const { return count + (current - buffer); }
+
+    // Not implemented.
+    void Put(Ch) { RAPIDJSON_ASSERT(false); }
+    void Flush() { RAPIDJSON_ASSERT(false); }
+    Ch *PutBegin() { RAPIDJSON_ASSERT(false); return nullptr; }
+    size_t PutEnd(Ch *) { RAPIDJSON_ASSERT(false); return 0; }
+
+private:
+    void read() {
+        if (current < buffer_last) {
+            current++;
+        } else if (!eof) {
+            count += read_count;
+
+            qint64 ret = file.read(buffer, sizeof(buffer));
+            read_count = ret > 0 ? (size_t)ret : 0;
+
+            buffer_last = buffer + read_count - 1;
+            current = buffer;
+
+            if (read_count < sizeof(buffer)) {
+                buffer[read_count] = '\0';
+                buffer_last++;
+                eof = true;
+            }
+        }
+    }
+
+    QFile &file;
+    char buffer[65536];
+    char *buffer_last = nullptr;
+    char *current;
+    size_t read_count = 0;
+    size_t count = 0;
+    bool eof = false;
+};
+
+
+enum ProjectColumnType {
+    ColumnIntegers,
+    ColumnIntegerArrays,
+    ColumnMatches
+};
+
+
+// A per-frame array from the project file. These are by far the biggest part
+// of a project, so they are collected while parsing instead of going into the DOM.
+struct ProjectColumn {
+    const char *key;
+    ProjectColumnType type;
+    size_t width; // Integers per element, for ColumnIntegerArrays.
+    std::string element_requirement;
+
+    bool present = false;
+    bool is_array = false;
+    size_t size = 0;
+
+    std::vector<int32_t> integers;
+    std::vector<char> characters;
+
+    // The first element that didn't meet element_requirement.
+    bool element_error = false;
+    size_t error_element = 0;
+
+    ProjectColumn(const char *_key, ProjectColumnType _type, size_t _width = 1)
+        : key(_key)
+        , type(_type)
+        , width(_width)
+    {
+        if (type == ColumnIntegers)
+            element_requirement = "must be an integer.";
+        else if (type == ColumnIntegerArrays)
+            element_requirement = "must be an array of exactly " + std::to_string(width) + " integers.";
+        else
+            element_requirement = "must be a string with the length of 1.";
+    }
+
+    void failElement() {
+        if (!element_error) {
+            element_error = true;
+            error_element = size;
+        }
+    }
+};
+
+
+// Forwards everything to a Document, except the values of the keys in columns.
+class ProjectReaderHandler {
+    rj::Document &document;
+    std::vector<ProjectColumn *> columns;
+
+    int depth = 0;
+    bool root_is_object = false;
+    rj::SizeType skipped_members = 0;
+
+    ProjectColumn *column = nullptr;
+    int column_depth = 0; // 1 means inside the column's array, 2 inside one of its elements.
+    bool element_valid = false;
+    size_t element_values = 0;
+
+    void columnInteger(bool is_int, int value) {
+        if (column_depth == 0) {
+            column = nullptr;
+        } else if (!column->is_array) {
+            return;
+        } else if (column_depth == 1) {
+            if (column->type == ColumnIntegers) {
+                column->integers.push_back(is_int ? value : 0);
+                if (!is_int)
+                    column->failElement();
+            } else if (column->type == ColumnIntegerArrays) {
+                column->integers.resize(column->integers.size() + column->width, 0);
+                column->failElement();
+            } else {
+                column->characters.push_back('c');
+                column->failElement();
+            }
+            column->size++;
+        } else if (column_depth == 2 && element_valid) {
+            if (is_int && element_values < column->width)
+                column->integers[column->size * column->width + element_values] = value;
+            else
+                element_valid = false;
+            element_values++;
+        }
+    }
+
+    void columnString(const char *str, rj::SizeType length) {
+        if (column_depth == 0) {
+            column = nullptr;
+        } else if (!column->is_array) {
+            return;
+        } else if (column_depth == 1) {
+            if (column->type == ColumnMatches) {
+                column->characters.push_back(length == 1 ? str[0] : 'c');
+                if (length != 1)
+                    column->failElement();
+            } else {
+                if (column->type == ColumnIntegers)
+                    column->integers.push_back(0);
+                else
+                    column->integers.resize(column->integers.size() + column->width, 0);
+                column->failElement();
+            }
+            column->size++;
+        } else if (column_depth == 2) {
+            element_valid = false;
+        }
+    }
+
+    void columnStart(bool is_array) {
+        if (column_depth == 0) {
+            column->is_array = is_array;
+        } else if (!column->is_array) {
+            // Contents of a column that isn't an array are irrelevant.
+        } else if (column_depth == 1) {
+            element_valid = is_array && column->type == ColumnIntegerArrays;
+            element_values = 0;
+
+            if (column->type == ColumnMatches)
+                column->characters.push_back('c');
+            else if (column->type == ColumnIntegers)
+                column->integers.push_back(0);
+            else
+                column->integers.resize(column->integers.size() + column->width, 0);
+        } else if (column_depth == 2) {
+            element_valid = false;
+        }
+
+        column_depth++;
+    }
+
+    void columnEnd() {
+        column_depth--;
+
+        if (column_depth == 0) {
+            column = nullptr;
+        } else if (column_depth == 1 && column->is_array) {
+            if (!element_valid || element_values != column->width)
+                column->failElement();
+            column->size++;
+        }
+    }
+
+public:
+    ProjectReaderHandler(rj::Document &_document, const std::vector<ProjectColumn *> &_columns)
+        : document(_document)
+        , columns(_columns)
+    { }
+
+    bool Null() {
+        if (column) {
+            columnInteger(false, 0);
+            return true;
+        }
+        return document.Null();
+    }
+
+    bool Bool(bool b) {
+        if (column) {
+            columnInteger(false, 0);
+            return true;
+        }
+        return document.Bool(b);
+    }
+
+    bool Int(int i) {
+        if (column) {
+            columnInteger(true, i);
+            return true;
+        }
+        return document.Int(i);
+    }
+
+    bool Uint(unsigned u) {
+        if (column) {
+            columnInteger(u <= (unsigned)INT32_MAX, (int)u);
+            return true;
+        }
+        return document.Uint(u);
+    }
+
+    bool Int64(int64_t i) {
+        if (column) {
+            columnInteger(false, 0);
+            return true;
+        }
+        return document.Int64(i);
+    }
+
+    bool Uint64(uint64_t u) {
+        if (column) {
+            columnInteger(false, 0);
+            return true;
+        }
+        return document.Uint64(u);
+    }
+
+    bool Double(double d) {
+        if (column) {
+            columnInteger(false, 0);
+            return true;
+        }
+        return document.Double(d);
+    }
+
+    bool RawNumber(const char *str, rj::SizeType length, bool copy) {
+        return document.RawNumber(str, length, copy);
+    }
+
+    bool String(const char *str, rj::SizeType length, bool copy) {
+        if (column) {
+            columnString(str, length);
+            return true;
+        }
+        return document.String(str, length, copy);
+    }
+
+    bool StartObject() {
+        if (column) {
+            columnStart(false);
+            return true;
+        }
+        if (depth == 0)
+            root_is_object = true;
+        depth++;
+        return document.StartObject();
+    }
+
+    bool Key(const char *str, rj::SizeType length, bool copy) {
+        // Keys inside a column only appear in elements that are invalid anyway.
+        if (column)
+            return true;
+
+        if (depth == 1 && root_is_object) {
+            for (size_t i = 0; i < columns.size(); i++) {
+                if (strlen(columns[i]->key) == length && !memcmp(columns[i]->key, str, length)) {
+                    column = columns[i];
+                    column->present = true;
+                    column_depth = 0;
+                    skipped_members++;
+                    return true;
+                }
+            }
+        }
+
+        return document.Key(str, length, copy);
+    }
+
+    bool EndObject(rj::SizeType member_count) {
+        if (column) {
+            columnEnd();
+            return true;
+        }
+        depth--;
+        if (depth == 0 && root_is_object)
+            member_count -= skipped_members;
+        return document.EndObject(member_count);
+    }
+
+    bool StartArray() {
+        if (column) {
+            columnStart(true);
+            return true;
+        }
+        depth++;
+        return document.StartArray();
+    }
+
+    bool EndArray(rj::SizeType element_count) {
+        if (column) {
+            columnEnd();
+            return true;
+        }
+        depth--;
+        return document.EndArray(element_count);
+    }
+};
+
+
+void WobblyProject::readColumnsFile(const std::string &project_path, const std::string &path) {
+    auto file = std::make_shared<QFile>(QString::fromStdString(path));
+
+    if (!file->open(QIODevice::ReadOnly))
+        throw WobblyException(project_path + ": couldn't open columns file '" + path + "'. Error message: " + file->errorString().toStdString());
+
+    uint64_t file_size = file->size();
+
+    // The mapping lives as long as the QFile, which the columns keep alive.
+    std::shared_ptr<const void> owner = file;
+    const char *contents = (const char *)file->map(0, file_size);
+
+    if (!contents) {
+        // Not every file can be mapped. Read it instead.
+        auto buffer = std::make_shared<QByteArray>(file->readAll());
+
+        if ((uint64_t)buffer->size() != file_size)
+            throw WobblyException(project_path + ": couldn't read columns file '" + path + "'. Error message: " + file->errorString().toStdString());
+
+        owner = buffer;
+        contents = buffer->constData();
+    }
+
+    if (owner == file)
+        mapped_columns_file = path;
+
+    std::string prefix = project_path + ": columns file '" + path + "' ";
+
+    ColumnsFileHeader header;
+
+    if (file_size < sizeof(header))
+        throw WobblyException(prefix + "is truncated.");
+
+    memcpy(&header, contents, sizeof(header));
+
+    if (memcmp(header.magic, columns_file_magic, sizeof(header.magic)))
+        throw WobblyException(prefix + "is not a Wobbly columns file.");
+
+    if (header.byte_order != columns_file_byte_order)
+        throw WobblyException(prefix + "was written on a machine with a different byte order.");
+
+    if (header.version > COLUMNS_FILE_VERSION)
+        throw WobblyException(prefix + "has format version " + std::to_string(header.version) + ", but this software only understands format version " + std::to_string(COLUMNS_FILE_VERSION) + " and older. Upgrade the software and try again.");
+
+    if (header.num_columns > (file_size - sizeof(header)) / sizeof(ColumnsFileEntry))
+        throw WobblyException(prefix + "is truncated.");
+
+    uint64_t expected_elements = getNumFrames(PostSource);
+
+    for (uint32_t i = 0; i < header.num_columns; i++) {
+        ColumnsFileEntry entry;
+        memcpy(&entry, contents + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+
+        auto borrowColumn = [&] (auto &column) {
+            typedef typename std::remove_reference<decltype(column)>::type::value_type T;
+
+            if (entry.element_size != sizeof(T))
+                throw WobblyException(prefix + "stores column '" + name + "' with " + std::to_string(entry.element_size) + "-byte elements, but " + std::to_string(sizeof(T)) + "-byte elements were expected.");
+
+            if (entry.num_elements != expected_elements)
+                throw WobblyException(prefix + "stores " + std::to_string(entry.num_elements) + " elements in column '" + name + "', but exactly " + std::to_string(expected_elements) + " were expected.");
+
+            if (entry.offset % COLUMNS_FILE_ALIGNMENT || entry.offset > file_size || (file_size - entry.offset) / sizeof(T) < expected_elements)
+                throw WobblyException(prefix + "is truncated.");
+
+            column.borrow(owner, (const T *)(contents + entry.offset), expected_elements);
+        };
+
+        auto checkMatches = [&] (const FrameColumn<char> &column) {
+            for (size_t j = 0; j < column.size(); j++)
+                if (!isValidMatchChar(column[j]))
+                    throw WobblyException(prefix + "stores an invalid match in element number " + std::to_string(j) + " of column '" + name + "'. Matches must be one of 'p', 'c', 'n', 'b', or 'u'.");
+        };
+
+        // Columns this version doesn't know about are skipped.
+        if (name == Keys::mics) {
+            borrowColumn(mics);
+        } else if (name == Keys::mmetrics) {
+            borrowColumn(mmetrics);
+        } else if (name == Keys::vmetrics) {
+            borrowColumn(vmetrics);
+        } else if (name == Keys::matches) {
+            borrowColumn(matches);
+            checkMatches(matches);
+        } else if (name == Keys::original_matches) {
+            borrowColumn(original_matches);
+            checkMatches(original_matches);
+        } else if (name == Keys::decimate_metrics) {
+            borrowColumn(decimate_metrics);
+        }
+    }
+}
+
+
 void WobblyProject::readProject(const std::string &path) {
     QFile file(QString::fromStdString(path));
 
     if (!file.open(QIODevice::ReadOnly))
         throw WobblyException("Couldn't open project file '" + path + "'. Error message: " + file.errorString().toStdString());
 
-    QByteArray file_contents = file.readAll();
+    BulkUpdate bulk_update(this);
+
+    ProjectColumn mmetrics_column(Keys::mmetrics, ColumnIntegerArrays, 2);
+    ProjectColumn vmetrics_column(Keys::vmetrics, ColumnIntegerArrays, 2);
+    ProjectColumn mics_column(Keys::mics, ColumnIntegerArrays, 5);
+    ProjectColumn matches_column(Keys::matches, ColumnMatches);
+    ProjectColumn original_matches_column(Keys::original_matches, ColumnMatches);
+    ProjectColumn decimate_metrics_column(Keys::decimate_metrics, ColumnIntegers);
 
     rj::Document json_project;
+    rj::ParseResult result;
+
+    {
+        QFileReadStream stream(file);
+        rj::Reader reader;
+
+        auto generator = [&] (rj::Document &document) {
+            ProjectReaderHandler handler(document, { &mmetrics_column, &vmetrics_column, &mics_column, &matches_column, &original_matches_column, &decimate_metrics_column });
+            result = reader.Parse(stream, handler);
+            return !result.IsError();
+        };
+
+        json_project.Populate(generator);
+    }
 
-    rj::ParseResult result = json_project.ParseInsitu(file_contents.data());
     if (result.IsError())
         throw WobblyException("Failed to parse project file '" + path + "' at byte " + std::to_string(result.Offset()) + ": " + rj::GetParseError_En(result.Code()));
 
@@ -1023,114 +1785,78 @@ void WobblyProject::readProject(const std::string &path) {
         }
     }
 
-    it = json_project.FindMember(Keys::mmetrics);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_mmetrics = it->value;
-
-        if (!json_mmetrics.IsArray() || json_mmetrics.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::mmetrics + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
-
-        mmetrics.resize(getNumFrames(PostSource), { 0 });
-        for (size_t i = 0; i < mmetrics.size(); i++) {
-            const rj::Value &json_mmetric = json_mmetrics[i];
+    QFileInfo info(QString::fromStdString(path));
+    project_file = info.absoluteFilePath().toStdString();
+    project_columns_file.clear();
 
-            if (!json_mmetric.IsArray() ||
-                json_mmetric.Size() != 2 ||
-                !json_mmetric[0].IsInt() ||
-                !json_mmetric[1].IsInt())
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::mmetrics + "' must be an array of exactly 2 integers.");
+    // Columns found in the JSON take precedence over the columns file.
+    it = json_project.FindMember(Keys::columns_file);
+    if (it != json_project.MemberEnd()) {
+        CHECK_STRING;
 
-            for (rj::SizeType j = 0; j < json_mmetric.Size(); j++)
-                mmetrics[i][j] = json_mmetric[j].GetInt();
-        }
+        project_columns_file = info.dir().absoluteFilePath(QString::fromUtf8(it->value.GetString())).toStdString();
+        readColumnsFile(path, project_columns_file);
     }
 
-    it = json_project.FindMember(Keys::vmetrics);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_vmetrics = it->value;
-
-        if (!json_vmetrics.IsArray() || json_vmetrics.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::vmetrics + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
+    auto checkColumn = [this, &path] (const ProjectColumn &column) -> bool {
+        if (!column.present)
+            return false;
 
-        vmetrics.resize(getNumFrames(PostSource), { 0 });
-        for (size_t i = 0; i < vmetrics.size(); i++) {
-            const rj::Value &json_vmetric = json_vmetrics[i];
+        if (!column.is_array || column.size != (size_t)getNumFrames(PostSource))
+            throw WobblyException(path + ": JSON key '" + column.key + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
 
-            if (!json_vmetric.IsArray() ||
-                json_vmetric.Size() != 2 ||
-                !json_vmetric[0].IsInt() ||
-                !json_vmetric[1].IsInt())
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::vmetrics + "' must be an array of exactly 2 integers.");
+        size_t error_element = column.element_error ? column.error_element : column.size;
+        std::string requirement = column.element_requirement;
 
-            for (rj::SizeType j = 0; j < json_vmetric.Size(); j++)
-                vmetrics[i][j] = json_vmetric[j].GetInt();
+        if (column.type == ColumnMatches) {
+            for (size_t i = 0; i < error_element; i++) {
+                if (!isValidMatchChar(column.characters[i])) {
+                    error_element = i;
+                    requirement = "must be one of 'p', 'c', 'n', 'b', or 'u'.";
+                    break;
+                }
+            }
         }
-    }
 
-    it = json_project.FindMember(Keys::mics);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_mics = it->value;
+        if (error_element < column.size)
+            throw WobblyException(path + ": element number " + std::to_string(error_element) + " of JSON key '" + column.key + "' " + requirement);
 
-        if (!json_mics.IsArray() || json_mics.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::mics + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
+        return true;
+    };
 
-        mics.resize(getNumFrames(PostSource), { 0 });
-        for (size_t i = 0; i < mics.size(); i++) {
-            const rj::Value &json_mic = json_mics[i];
-
-            if (!json_mic.IsArray() ||
-                    json_mic.Size() != 5 ||
-                    !json_mic[0].IsInt() ||
-                    !json_mic[1].IsInt() ||
-                    !json_mic[2].IsInt() ||
-                    !json_mic[3].IsInt() ||
-                    !json_mic[4].IsInt())
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::mics + "' must be an array of exactly 5 integers.");
-
-            for (rj::SizeType j = 0; j < json_mic.Size(); j++)
-                mics[i][j] = json_mic[j].GetInt();
-        }
+    if (checkColumn(mmetrics_column)) {
+        mmetrics.resize(getNumFrames(PostSource), { 0 });
+        auto mmetrics_data = mmetrics.mutableData();
+        for (size_t i = 0; i < mmetrics.size(); i++)
+            for (size_t j = 0; j < 2; j++)
+                mmetrics_data[i][j] = mmetrics_column.integers[i * 2 + j];
     }
 
-
-    it = json_project.FindMember(Keys::matches);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_matches = it->value;
-
-        if (!json_matches.IsArray() || json_matches.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::matches + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
-
-        matches.resize(getNumFrames(PostSource), 'c');
-        for (size_t i = 0; i < matches.size(); i++) {
-            if (!json_matches[i].IsString() || json_matches[i].GetStringLength() != 1)
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::matches + "' must be a string with the length of 1.");
-
-            matches[i] = json_matches[i].GetString()[0];
-
-            if (!isValidMatchChar(matches[i]))
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::matches + "' must be one of 'p', 'c', 'n', 'b', or 'u'.");
-        }
+    if (checkColumn(vmetrics_column)) {
+        vmetrics.resize(getNumFrames(PostSource), { 0 });
+        auto vmetrics_data = vmetrics.mutableData();
+        for (size_t i = 0; i < vmetrics.size(); i++)
+            for (size_t j = 0; j < 2; j++)
+                vmetrics_data[i][j] = vmetrics_column.integers[i * 2 + j];
     }
 
+    if (checkColumn(mics_column)) {
+        mics.resize(getNumFrames(PostSource), { 0 });
+        auto mics_data = mics.mutableData();
+        for (size_t i = 0; i < mics.size(); i++)
+            for (size_t j = 0; j < 5; j++)
+                mics_data[i][j] = mics_column.integers[i * 5 + j];
+    }
 
-    it = json_project.FindMember(Keys::original_matches);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_original_matches = it->value;
 
-        if (!json_original_matches.IsArray() || json_original_matches.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::original_matches + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
+    if (checkColumn(matches_column))
+        matches = std::move(matches_column.characters);
 
-        original_matches.resize(getNumFrames(PostSource), 'c');
-        for (size_t i = 0; i < original_matches.size(); i++) {
-            if (!json_original_matches[i].IsString() || json_original_matches[i].GetStringLength() != 1)
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::original_matches + "' must be a string with the length of 1.");
 
-            original_matches[i] = json_original_matches[i].GetString()[0];
+    if (checkColumn(original_matches_column))
+        original_matches = std::move(original_matches_column.characters);
 
-            if (!isValidMatchChar(original_matches[i]))
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::original_matches + "' must be one of 'p', 'c', 'n', 'b', or 'u'.");
-        }
-    }
+    search_indices_built = false;
 
 
     it = json_project.FindMember(Keys::combed_frames);
@@ -1147,7 +1873,7 @@ void WobblyProject::readProject(const std::string &path) {
         }
     }
 
-    decimated_frames.resize((getNumFrames(PostSource) - 1) / 5 + 1);
+    resetDecimatedFrames();
     it = json_project.FindMember(Keys::decimated_frames);
     if (it != json_project.MemberEnd()) {
         const rj::Value &json_decimated_frames = it->value;
@@ -1164,20 +1890,8 @@ void WobblyProject::readProject(const std::string &path) {
 
     // getNumFrames(PostDecimate) is correct at this point.
 
-    it = json_project.FindMember(Keys::decimate_metrics);
-    if (it != json_project.MemberEnd()) {
-        const rj::Value &json_decimate_metrics = it->value;
-
-        if (!json_decimate_metrics.IsArray() || json_decimate_metrics.Size() != (rj::SizeType)getNumFrames(PostSource))
-            throw WobblyException(path + ": JSON key '" + Keys::decimate_metrics + "' must be an array with exactly " + std::to_string(getNumFrames(PostSource)) + " elements.");
-
-        decimate_metrics.resize(getNumFrames(PostSource), 0);
-        for (size_t i = 0; i < decimate_metrics.size(); i++) {
-            if (!json_decimate_metrics[i].IsInt())
-                throw WobblyException(path + ": element number " + std::to_string(i) + " of JSON key '" + Keys::decimate_metrics + "' must be an integer.");
-            decimate_metrics[i] = json_decimate_metrics[i].GetInt();
-        }
-    }
+    if (checkColumn(decimate_metrics_column))
+        decimate_metrics = std::move(decimate_metrics_column.integers);
 
 
     it = json_project.FindMember(Keys::presets);
@@ -1752,12 +2466,14 @@ void WobblyProject::setMics(int frame, int16_t mic_p, int16_t mic_c, int16_t mic
     if (!mics.size())
         mics.resize(getNumFrames(PostSource), { 0 });
 
-    auto &mic = mics[frame];
+    auto &mic = mics.modify(frame);
     mic[0] = mic_p;
     mic[1] = mic_c;
     mic[2] = mic_n;
     mic[3] = mic_b;
     mic[4] = mic_u;
+
+    updateSearchIndices(frame, frame);
 }
 
 
@@ -1771,13 +2487,76 @@ void WobblyProject::setDMetrics(int frame, int32_t mmetric_p, int32_t mmetric_c,
     if (!vmetrics.size())
         vmetrics.resize(getNumFrames(PostSource), { 0 });
 
-    auto &mmetric = mmetrics[frame];
+    auto &mmetric = mmetrics.modify(frame);
     mmetric[0] = mmetric_p;
     mmetric[1] = mmetric_c;
 
-    auto &vmetric = vmetrics[frame];
+    auto &vmetric = vmetrics.modify(frame);
     vmetric[0] = vmetric_p;
     vmetric[1] = vmetric_c;
+
+    updateSearchIndices(frame, frame);
+}
+
+
+int16_t WobblyProject::getSearchMic(int frame) const {
+    int prev_idx = std::max(frame - 1, 0);
+    int next_idx = std::min(frame + 1, getNumFrames(PostSource) - 1);
+
+    int16_t prev = getMics(prev_idx)[matchCharToIndex(getMatch(prev_idx))];
+    int16_t curr = getMics(frame)[matchCharToIndex(getMatch(frame))];
+    int16_t next = getMics(next_idx)[matchCharToIndex(getMatch(next_idx))];
+
+    // The first and last frames have only one neighbour.
+    return (frame == prev_idx || frame == next_idx) ? curr : std::min(curr - prev, curr - next);
+}
+
+
+int32_t WobblyProject::getSearchDMetric(int frame) const {
+    int prev_idx = std::max(frame - 1, 0);
+    int next_idx = std::min(frame + 1, getNumFrames(PostSource) - 1);
+
+    int32_t prev = getVMetrics(prev_idx)[matchCharToIndexDMetrics(getMatch(prev_idx))];
+    int32_t curr = getVMetrics(frame)[matchCharToIndexDMetrics(getMatch(frame))];
+    int32_t next = getVMetrics(next_idx)[matchCharToIndexDMetrics(getMatch(next_idx))];
+
+    return (frame == prev_idx || frame == next_idx) ? curr : std::min(curr - prev, curr - next);
+}
+
+
+void WobblyProject::buildSearchIndices() const {
+    if (search_indices_built)
+        return;
+
+    std::vector<int16_t> search_mics(getNumFrames(PostSource));
+    std::vector<int32_t> search_dmetrics(getNumFrames(PostSource));
+
+    for (int i = 0; i < getNumFrames(PostSource); i++) {
+        search_mics[i] = getSearchMic(i);
+        search_dmetrics[i] = getSearchDMetric(i);
+    }
+
+    mic_search_index.assign(std::move(search_mics));
+    dmetric_search_index.assign(std::move(search_dmetrics));
+
+    search_indices_built = true;
+}
+
+
+// Call after changing the match, mics, or dmetrics of frames [first,last].
+void WobblyProject::updateSearchIndices(int first, int last) {
+    if (!search_indices_built)
+        return;
+
+    // A frame's search values also depend on its neighbours, and its
+    // vmetrics come partly from the next frame.
+    first = std::max(first - 2, 0);
+    last = std::min(last + 1, getNumFrames(PostSource) - 1);
+
+    for (int i = first; i <= last; i++) {
+        mic_search_index.set(i, getSearchMic(i));
+        dmetric_search_index.set(i, getSearchDMetric(i));
+    }
 }
 
 
@@ -1785,21 +2564,9 @@ int WobblyProject::getPreviousFrameWithMic(int minimum, int start_frame) const {
     if (start_frame < 0 || start_frame >= getNumFrames(PostSource))
         throw WobblyException("Can't get the previous frame with mic " + std::to_string(minimum) + " or greater: frame " + std::to_string(start_frame) + " is out of range.");
 
-    for (int i = start_frame - 1; i >= 0; i--) {
-        int prev_idx = std::max(i - 1, 0);
-        int next_idx = std::min(i + 1, getNumFrames(PostSource) - 1);
-
-        int16_t prev = getMics(prev_idx)[matchCharToIndex(getMatch(prev_idx))];
-        int16_t curr = getMics(i)[matchCharToIndex(getMatch(i))];
-        int16_t next = getMics(next_idx)[matchCharToIndex(getMatch(next_idx))];
-
-        int16_t mic = i == prev_idx ? curr : std::min(curr - prev, curr - next);
+    buildSearchIndices();
 
-        if (mic >= minimum)
-            return i;
-    }
-
-    return -1;
+    return mic_search_index.findPrevious(start_frame - 1, minimum);
 }
 
 
@@ -1807,42 +2574,18 @@ int WobblyProject::getNextFrameWithMic(int minimum, int start_frame) const {
     if (start_frame < 0 || start_frame >= getNumFrames(PostSource))
         throw WobblyException("Can't get the next frame with mic " + std::to_string(minimum) + " or greater: frame " + std::to_string(start_frame) + " is out of range.");
 
-    for (int i = start_frame + 1; i < getNumFrames(PostSource); i++) {
-        int prev_idx = std::max(i - 1, 0);
-        int next_idx = std::min(i + 1, getNumFrames(PostSource) - 1);
-
-        int16_t prev = getMics(prev_idx)[matchCharToIndex(getMatch(prev_idx))];
-        int16_t curr = getMics(i)[matchCharToIndex(getMatch(i))];
-        int16_t next = getMics(next_idx)[matchCharToIndex(getMatch(next_idx))];
-
-        int16_t mic = i == next_idx ? curr : std::min(curr - prev, curr - next);
+    buildSearchIndices();
 
-        if (mic >= minimum)
-            return i;
-    }
-
-    return -1;
+    return mic_search_index.findNext(start_frame + 1, minimum);
 }
 
 int WobblyProject::getPreviousFrameWithDMetric(int minimum, int start_frame) const {
     if (start_frame < 0 || start_frame >= getNumFrames(PostSource))
         throw WobblyException("Can't get the previous frame with dmetric " + std::to_string(minimum) + " or greater: frame " + std::to_string(start_frame) + " is out of range.");
 
-    for (int i = start_frame - 1; i >= 0; i--) {
-        int prev_idx = std::max(i - 1, 0);
-        int next_idx = std::min(i + 1, getNumFrames(PostSource) - 1);
-
-        int32_t prev = getVMetrics(prev_idx)[matchCharToIndexDMetrics(getMatch(prev_idx))];
-        int32_t curr = getVMetrics(i)[matchCharToIndexDMetrics(getMatch(i))];
-        int32_t next = getVMetrics(next_idx)[matchCharToIndexDMetrics(getMatch(next_idx))];
-
-        int32_t vmet = i == prev_idx ? curr : std::min(curr - prev, curr - next);
+    buildSearchIndices();
 
-        if (vmet >= minimum)
-            return i;
-    }
-
-    return -1;
+    return dmetric_search_index.findPrevious(start_frame - 1, minimum);
 }
 
 
@@ -1850,21 +2593,9 @@ int WobblyProject::getNextFrameWithDMetric(int minimum, int start_frame) const {
     if (start_frame < 0 || start_frame >= getNumFrames(PostSource))
         throw WobblyException("Can't get the next frame with dmetric " + std::to_string(minimum) + " or greater: frame " + std::to_string(start_frame) + " is out of range.");
 
-    for (int i = start_frame + 1; i < getNumFrames(PostSource); i++) {
-        int prev_idx = std::max(i - 1, 0);
-        int next_idx = std::min(i + 1, getNumFrames(PostSource) - 1);
-
-        int32_t prev = getVMetrics(prev_idx)[matchCharToIndexDMetrics(getMatch(prev_idx))];
-        int32_t curr = getVMetrics(i)[matchCharToIndexDMetrics(getMatch(i))];
-        int32_t next = getVMetrics(next_idx)[matchCharToIndexDMetrics(getMatch(next_idx))];
-
-        int32_t vmet = i == next_idx ? curr : std::min(curr - prev, curr - next);
+    buildSearchIndices();
 
-        if (vmet >= minimum)
-            return i;
-    }
-
-    return -1;
+    return dmetric_search_index.findNext(start_frame + 1, minimum);
 }
 
 
@@ -1889,7 +2620,10 @@ void WobblyProject::setOriginalMatch(int frame, char match) {
     if (!original_matches.size())
         original_matches.resize(getNumFrames(PostSource), 'c');
 
-    original_matches[frame] = match;
+    original_matches.modify(frame) = match;
+
+    if (!matches.size())
+        updateSearchIndices(frame, frame);
 }
 
 
@@ -1925,10 +2659,14 @@ void WobblyProject::setMatch(int frame, char match) {
             match = 'p';
     }
 
-    if (!matches.size())
+    if (!matches.size()) {
         matches.resize(getNumFrames(PostSource), 'c');
+        search_indices_built = false; // getMatch() no longer falls back to original_matches.
+    }
+
+    matches.modify(frame) = match;
 
-    matches[frame] = match;
+    updateSearchIndices(frame, frame);
 }
 
 
@@ -2231,13 +2969,17 @@ void WobblyProject::resetRangeMatches(int start, int end) {
     if (start < 0 || end >= getNumFrames(PostSource))
         throw WobblyException("Can't reset the matches for frames [" + std::to_string(start) + "," + std::to_string(end) + "]: values out of range.");
 
-    if (!matches.size())
+    if (!matches.size()) {
         matches.resize(getNumFrames(PostSource), 'c');
+        search_indices_built = false; // getMatch() no longer falls back to original_matches.
+    }
 
     if (original_matches.size())
-        memcpy(matches.data() + start, original_matches.data() + start, end - start + 1);
+        memcpy(matches.mutableData() + start, original_matches.data() + start, end - start + 1);
     else
-        memset(matches.data() + start, 'c', end - start + 1);
+        memset(matches.mutableData() + start, 'c', end - start + 1);
+
+    updateSearchIndices(start, end);
 
     setModified(true);
 }
@@ -2520,7 +3262,27 @@ void WobblyProject::setDecimateMetric(int frame, int decimate_metric) {
     if (!decimate_metrics.size())
         decimate_metrics.resize(getNumFrames(PostSource), 0);
 
-    decimate_metrics[frame] = decimate_metric;
+    decimate_metrics.modify(frame) = decimate_metric;
+}
+
+
+void WobblyProject::resetDecimatedFrames() {
+    decimated_frames.assign((getNumFrames(PostSource) - 1) / 5 + 1, 0);
+    decimation_index.assign(std::vector<int>(decimated_frames.size(), 5));
+}
+
+
+// Keeps decimation_index and the number of frames after decimation up to date.
+void WobblyProject::setDecimatedCycle(size_t cycle, uint8_t dropped) {
+    int difference = std::popcount(dropped) - std::popcount(decimated_frames[cycle]);
+
+    decimated_frames[cycle] = dropped;
+
+    if (difference) {
+        decimation_index.add(cycle, -difference);
+
+        setNumFrames(PostDecimate, getNumFrames(PostDecimate) - difference);
+    }
 }
 
 
@@ -2528,14 +3290,15 @@ void WobblyProject::addDecimatedFrame(int frame) {
     if (frame < 0 || frame >= getNumFrames(PostSource))
         throw WobblyException("Can't mark frame " + std::to_string(frame) + " for decimation: value out of range.");
 
+    uint8_t cycle = decimated_frames[frame / 5];
+    uint8_t bit = 1 << (frame % 5);
+
     // Don't allow decimating all the frames in a cycle.
-    if (decimated_frames[frame / 5].size() == 5 - 1)
+    if (std::popcount(cycle) == 5 - 1)
         return;
 
-    auto result = decimated_frames[frame / 5].insert(frame % 5);
-
-    if (result.second) {
-        setNumFrames(PostDecimate, getNumFrames(PostDecimate) - 1);
+    if (!(cycle & bit)) {
+        setDecimatedCycle(frame / 5, cycle | bit);
 
         setModified(true);
     }
@@ -2546,10 +3309,11 @@ void WobblyProject::deleteDecimatedFrame(int frame) {
     if (frame < 0 || frame >= getNumFrames(PostSource))
         throw WobblyException("Can't delete decimated frame " + std::to_string(frame) + ": value out of range.");
 
-    size_t result = decimated_frames[frame / 5].erase(frame % 5);
+    uint8_t cycle = decimated_frames[frame / 5];
+    uint8_t bit = 1 << (frame % 5);
 
-    if (result) {
-        setNumFrames(PostDecimate, getNumFrames(PostDecimate) + 1);
+    if (cycle & bit) {
+        setDecimatedCycle(frame / 5, cycle & ~bit);
 
         setModified(true);
     }
@@ -2560,7 +3324,7 @@ bool WobblyProject::isDecimatedFrame(int frame) const {
     if (frame < 0 || frame >= getNumFrames(PostSource))
         throw WobblyException("Can't check if frame " + std::to_string(frame) + " is decimated: value out of range.");
 
-    return (bool)decimated_frames[frame / 5].count(frame % 5);
+    return (decimated_frames[frame / 5] >> (frame % 5)) & 1;
 }
 
 
@@ -2568,13 +3332,7 @@ void WobblyProject::clearDecimatedFramesFromCycle(int frame) {
     if (frame < 0 || frame >= getNumFrames(PostSource))
         throw WobblyException("Can't clear decimated frames from cycle containing frame " + std::to_string(frame) + ": value out of range.");
 
-    int cycle = frame / 5;
-
-    size_t new_frames = decimated_frames[cycle].size();
-
-    decimated_frames[cycle].clear();
-
-    setNumFrames(PostDecimate, getNumFrames(PostDecimate) + new_frames);
+    setDecimatedCycle(frame / 5, 0);
 }
 
 
@@ -2585,9 +3343,11 @@ DecimationRangeVector WobblyProject::getDecimationRanges() const {
     current_range.num_dropped = -1;
 
     for (size_t i = 0; i < decimated_frames.size(); i++) {
-        if ((int)decimated_frames[i].size() != current_range.num_dropped) {
+        int num_dropped = std::popcount(decimated_frames[i]);
+
+        if (num_dropped != current_range.num_dropped) {
             current_range.start = i * 5;
-            current_range.num_dropped = decimated_frames[i].size();
+            current_range.num_dropped = num_dropped;
             ranges.push_back(current_range);
         }
     }
@@ -2596,29 +3356,22 @@ DecimationRangeVector WobblyProject::getDecimationRanges() const {
 }
 
 
-static bool areDecimationPatternsEqual(const std::set<int8_t> &a, const std::set<int8_t> &b) {
-    if (a.size() != b.size())
-        return false;
-
-    for (auto it1 = a.cbegin(), it2 = b.cbegin(); it1 != a.cend(); it1++, it2++)
-        if (*it1 != *it2)
-            return false;
-
-    return true;
-}
-
-
 DecimationPatternRangeVector WobblyProject::getDecimationPatternRanges() const {
     DecimationPatternRangeVector ranges;
 
-    DecimationPatternRange current_range;
-    current_range.dropped_offsets.insert(-1);
+    int current_pattern = -1;
 
     for (size_t i = 0; i < decimated_frames.size(); i++) {
-        if (!areDecimationPatternsEqual(decimated_frames[i], current_range.dropped_offsets)) {
-            current_range.start = i * 5;
-            current_range.dropped_offsets = decimated_frames[i];
-            ranges.push_back(current_range);
+        if (decimated_frames[i] != current_pattern) {
+            current_pattern = decimated_frames[i];
+
+            DecimationPatternRange range;
+            range.start = i * 5;
+            for (int8_t j = 0; j < 5; j++)
+                if (current_pattern & (1 << j))
+                    range.dropped_offsets.insert(j);
+
+            ranges.push_back(range);
         }
     }
 
@@ -2663,6 +3416,8 @@ std::map<size_t, size_t> WobblyProject::getCMatchSequences(int minimum) const {
 
 
 void WobblyProject::updateOrphanFields() {
+    BulkUpdate bulk_update(this);
+
     // Find the ends manually so this is not O(#sections^2)
     auto it = sections->cbegin();
     while (it != sections->cend()) {
@@ -2859,12 +3614,27 @@ void WobblyProject::setFreezeFramesWanted(bool wanted) {
 }
 
 
+const std::shared_ptr<FrameOverrides> &WobblyProject::getFrameOverrides() const {
+    return frame_overrides;
+}
+
+
+bool WobblyProject::updateFrameOverrides(int *first_changed, int *last_changed) {
+    const FrameColumn<char> &current_matches = matches.size() ? matches : original_matches;
+
+    return frame_overrides->update(current_matches.data(), current_matches.size(), *frozen_frames, freeze_frames_wanted, vfm_parameters_int.at("order"), first_changed, last_changed);
+}
+
+
 bool WobblyProject::isModified() const {
     return is_modified;
 }
 
 
 void WobblyProject::setModified(bool modified) {
+    if (modified)
+        modification_count++;
+
     if (modified != is_modified) {
         is_modified = modified;
 
@@ -2873,6 +3643,142 @@ void WobblyProject::setModified(bool modified) {
 }
 
 
+uint64_t WobblyProject::getModificationCount() const {
+    return modification_count;
+}
+
+
+WobblyProject *WobblyProject::snapshot() const {
+    WobblyProject *copy = new WobblyProject(is_wobbly);
+
+    copy->num_frames[0] = num_frames[0];
+    copy->num_frames[1] = num_frames[1];
+    copy->fps_num = fps_num;
+    copy->fps_den = fps_den;
+    copy->width = width;
+    copy->height = height;
+
+    copy->zoom = zoom;
+    copy->last_visited_frame = last_visited_frame;
+    copy->ui_state = ui_state;
+    copy->ui_geometry = ui_geometry;
+    copy->shown_frame_rates = shown_frame_rates;
+    copy->mic_search_minimum = mic_search_minimum;
+    copy->dmetric_search_minimum = dmetric_search_minimum;
+    copy->c_match_sequences_minimum = c_match_sequences_minimum;
+
+    copy->input_file = input_file;
+    copy->trims = trims;
+
+    copy->vfm_parameters_int = vfm_parameters_int;
+    copy->vfm_parameters_double = vfm_parameters_double;
+    copy->vfm_parameters_bool = vfm_parameters_bool;
+
+    copy->vdecimate_parameters_int = vdecimate_parameters_int;
+    copy->vdecimate_parameters_double = vdecimate_parameters_double;
+    copy->vdecimate_parameters_bool = vdecimate_parameters_bool;
+
+    copy->project_file = project_file;
+    copy->project_columns_file = project_columns_file;
+    copy->mapped_columns_file = mapped_columns_file;
+
+    // Mapped columns are shared, not copied.
+    copy->mics = mics;
+    copy->mmetrics = mmetrics;
+    copy->vmetrics = vmetrics;
+    copy->matches = matches;
+    copy->original_matches = original_matches;
+    copy->decimated_frames = decimated_frames;
+    copy->decimation_index = decimation_index;
+    copy->decimate_metrics = decimate_metrics;
+
+    copy->pattern_guessing = pattern_guessing;
+
+    copy->interlaced_fades = interlaced_fades;
+
+    for (auto const& c : *combed_frames)
+        copy->combed_frames->insert(c);
+
+    for (auto it = orphan_fields->cbegin(); it != orphan_fields->cend(); it++)
+        copy->orphan_fields->insert(*it);
+
+    for (auto const& f : *frozen_frames)
+        copy->frozen_frames->insert(f);
+
+    for (auto const& p : *presets)
+        copy->presets->insert(p);
+
+    // The ranges are models of their own, so they can't be shared.
+    for (auto const& c : *custom_lists) {
+        copy->custom_lists->push_back(c);
+        copy->custom_lists->back().ranges = std::make_shared<FrameRangesModel>();
+        for (auto const& r : *c.ranges)
+            copy->custom_lists->back().ranges->insert(r);
+    }
+
+    for (auto const& s : *sections)
+        copy->sections->insert(s);
+
+    for (auto const& b : *bookmarks)
+        copy->bookmarks->insert(b);
+
+    copy->dmetrics = dmetrics;
+    copy->resize = resize;
+    copy->crop = crop;
+    copy->depth = depth;
+
+    copy->source_filter = source_filter;
+
+    copy->freeze_frames_wanted = freeze_frames_wanted;
+
+    copy->is_modified = is_modified;
+
+    return copy;
+}
+
+
+void WobblyProject::detachColumns() {
+    mics.detach();
+    mmetrics.detach();
+    vmetrics.detach();
+    matches.detach();
+    original_matches.detach();
+    decimate_metrics.detach();
+}
+
+
+void WobblyProject::finishSnapshotSave(WobblyProject *snapshot) {
+    project_file = snapshot->project_file;
+    project_columns_file = snapshot->project_columns_file;
+
+    // This project may still have it mapped.
+    if (snapshot->obsolete_columns_file.size())
+        removeColumnsFile(snapshot->obsolete_columns_file);
+}
+
+
+void WobblyProject::beginBulkUpdate() {
+    combed_frames->beginBatch();
+    orphan_fields->beginBatch();
+    frozen_frames->beginBatch();
+    presets->beginBatch();
+    custom_lists->beginBatch();
+    sections->beginBatch();
+    bookmarks->beginBatch();
+}
+
+
+void WobblyProject::endBulkUpdate() {
+    combed_frames->endBatch();
+    orphan_fields->endBatch();
+    frozen_frames->endBatch();
+    presets->endBatch();
+    custom_lists->endBatch();
+    sections->endBatch();
+    bookmarks->endBatch();
+}
+
+
 std::string WobblyProject::getUndoDescription() {
     if (undo_stack.size() <= 1)
         return "";
@@ -2885,81 +3791,369 @@ std::string WobblyProject::getRedoDescription() {
     return redo_stack.back().description;
 }
 
-void WobblyProject::restoreState(UndoStep state) {
-    matches = state.matches;
-    decimated_frames = state.decimated_frames;
-    pattern_guessing = state.pattern_guessing;
+static int elementKey(int element) {
+    return element;
+}
+
+
+template <typename Key, typename Value>
+static const Key &elementKey(const std::pair<Key, Value> &element) {
+    return element.first;
+}
+
+
+// Both containers must be sorted by elementKey.
+template <typename Before, typename After, typename T>
+static void findElementChanges(const Before &before, const After &after, ElementChanges<T> &changes) {
+    auto b = before.cbegin();
+    auto a = after.cbegin();
+
+    while (b != before.cend() || a != after.cend()) {
+        if (a == after.cend() || (b != before.cend() && elementKey(*b) < elementKey(*a))) {
+            changes.removed.push_back(*b);
+            b++;
+        } else if (b == before.cend() || elementKey(*a) < elementKey(*b)) {
+            changes.added.push_back(*a);
+            a++;
+        } else {
+            if (!(*b == *a)) {
+                changes.removed.push_back(*b);
+                changes.added.push_back(*a);
+            }
+            b++;
+            a++;
+        }
+    }
+}
+
+
+// For the models, which announce every row they add or remove.
+template <typename Container, typename T>
+static void applyElementChanges(Container &container, const std::vector<T> &erase, const std::vector<T> &insert) {
+    for (auto const& e : erase)
+        container.erase(elementKey(e));
+
+    for (auto const& i : insert)
+        container.insert(i);
+}
+
+
+static bool areCustomListsEqual(const CustomListVector &a, const CustomListVector &b) {
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].name != b[i].name || a[i].preset != b[i].preset || a[i].position != b[i].position)
+            return false;
+
+        const FrameRangeMap &a_ranges = *a[i].ranges;
+        const FrameRangeMap &b_ranges = *b[i].ranges;
+
+        if (a_ranges != b_ranges)
+            return false;
+    }
+
+    return true;
+}
+
 
-    presets->clear();
-    for (auto const& p : state.presets)
-        presets->insert(p);
+// Gives every list its own copy of the ranges.
+template <typename Container>
+static void copyCustomLists(const CustomListVector &from, Container &to) {
+    to.clear();
 
-    custom_lists->clear();
-    for (auto const& c : state.custom_lists) {
-        custom_lists->push_back(c);
-        custom_lists->back().ranges = std::make_shared<FrameRangesModel>();
+    for (auto const& c : from) {
+        to.push_back(c);
+        to.back().ranges = std::make_shared<FrameRangesModel>();
         for (auto const& r : *c.ranges)
-            custom_lists->back().ranges->insert(r);
+            to.back().ranges->insert(r);
     }
+}
 
-    combed_frames->clear();
-    for (auto const& c : state.combed_frames)
-        combed_frames->insert(c);
 
-    frozen_frames->clear();
-    for (auto const& f : state.frozen_frames)
-        frozen_frames->insert(f);
+// Nodes of std::set and std::map carry three pointers and a colour.
+static const size_t tree_node_overhead = 4 * sizeof(void *);
+
+
+static size_t stringFootprint(const std::string &s) {
+    return s.capacity();
+}
+
+
+static size_t elementFootprint(int) {
+    return 0;
+}
+
+
+static size_t elementFootprint(const PresetMap::value_type &preset) {
+    return stringFootprint(preset.first) + stringFootprint(preset.second.name) + stringFootprint(preset.second.contents);
+}
+
+
+static size_t elementFootprint(const FreezeFrameMap::value_type &) {
+    return 0;
+}
+
+
+static size_t elementFootprint(const SectionMap::value_type &section) {
+    size_t bytes = section.second.presets.capacity() * sizeof(std::string);
+    for (auto const& p : section.second.presets)
+        bytes += stringFootprint(p);
+    return bytes;
+}
+
+
+static size_t elementFootprint(const BookmarkMap::value_type &bookmark) {
+    return stringFootprint(bookmark.second.description);
+}
+
+
+template <typename T>
+static size_t elementChangesFootprint(const ElementChanges<T> &changes) {
+    size_t bytes = (changes.removed.capacity() + changes.added.capacity()) * sizeof(T);
+
+    for (auto const& e : changes.removed)
+        bytes += elementFootprint(e);
+    for (auto const& e : changes.added)
+        bytes += elementFootprint(e);
+
+    return bytes;
+}
+
+
+static size_t customListsFootprint(const CustomListVector &lists) {
+    size_t bytes = lists.capacity() * sizeof(CustomList);
+
+    for (auto const& c : lists)
+        bytes += stringFootprint(c.name) + stringFootprint(c.preset) + sizeof(FrameRangesModel) + c.ranges->size() * sizeof(FrameRangeMap::value_type);
+
+    return bytes;
+}
+
+
+template <typename Container>
+static size_t flatContainerFootprint(const Container &container) {
+    size_t bytes = container.capacity() * sizeof(typename Container::value_type);
+
+    for (auto const& e : container)
+        bytes += elementFootprint(e);
+
+    return bytes;
+}
+
+
+size_t UndoState::footprint() const {
+    size_t bytes = sizeof(UndoState);
+
+    bytes += matches.capacity() + decimated_frames.capacity();
+
+    bytes += pattern_guessing.failures.size() * (tree_node_overhead + sizeof(FailedPatternGuessingMap::value_type));
+
+    bytes += flatContainerFootprint(presets);
+    bytes += customListsFootprint(custom_lists);
+    bytes += flatContainerFootprint(combed_frames);
+    bytes += flatContainerFootprint(frozen_frames);
+    bytes += flatContainerFootprint(sections);
+    bytes += flatContainerFootprint(bookmarks);
+
+    return bytes;
+}
+
+
+size_t UndoStep::footprint() const {
+    size_t bytes = sizeof(UndoStep) + stringFootprint(description);
+
+    bytes += old_matches.capacity() + new_matches.capacity();
+
+    bytes += decimated_cycles.capacity() * sizeof(size_t);
+    bytes += old_decimated_frames.capacity() + new_decimated_frames.capacity();
+
+    bytes += (old_pattern_guessing.failures.size() + new_pattern_guessing.failures.size()) * (tree_node_overhead + sizeof(FailedPatternGuessingMap::value_type));
+
+    bytes += elementChangesFootprint(presets);
+    bytes += customListsFootprint(old_custom_lists) + customListsFootprint(new_custom_lists);
+    bytes += elementChangesFootprint(combed_frames);
+    bytes += elementChangesFootprint(frozen_frames);
+    bytes += elementChangesFootprint(sections);
+    bytes += elementChangesFootprint(bookmarks);
+
+    return bytes;
+}
+
+
+static void forgetChanges(UndoStep &step) {
+    std::string description = std::move(step.description);
+
+    step = UndoStep();
+    step.description = std::move(description);
+}
+
+
+void WobblyProject::popOldestUndoStep() {
+    undo_memory -= undo_stack.front().footprint();
+    undo_stack.pop_front();
+
+    if (undo_stack.size()) {
+        undo_memory -= undo_stack.front().footprint();
+        forgetChanges(undo_stack.front());
+        undo_memory += undo_stack.front().footprint();
+    }
+}
+
+
+void WobblyProject::trimUndoHistory() {
+    // The newest step stays even if it's over budget, so the most recent action can always be undone.
+    // committed_state can't shrink, but it counts towards the budget all the same.
+    while (undo_stack.size() > undo_steps || (undo_memory + committed_state_memory > undo_memory_budget && undo_stack.size() > 2))
+        popOldestUndoStep();
+}
+
+
+void WobblyProject::applyUndoStep(const UndoStep &step, bool redo) {
+    BulkUpdate bulk_update(this);
+
+    const std::vector<char> &step_matches = redo ? step.new_matches : step.old_matches;
+
+    if (step.old_matches.size() != step.new_matches.size()) {
+        matches = step_matches;
+        committed_state.matches = step_matches;
+        search_indices_built = false;
+    } else if (step_matches.size()) {
+        memcpy(matches.mutableData() + step.matches_start, step_matches.data(), step_matches.size());
+        memcpy(committed_state.matches.data() + step.matches_start, step_matches.data(), step_matches.size());
+        updateSearchIndices((int)step.matches_start, (int)(step.matches_start + step_matches.size()) - 1);
+    }
+
+    const std::vector<uint8_t> &step_decimated_frames = redo ? step.new_decimated_frames : step.old_decimated_frames;
+
+    for (size_t i = 0; i < step.decimated_cycles.size(); i++) {
+        setDecimatedCycle(step.decimated_cycles[i], step_decimated_frames[i]);
+        committed_state.decimated_frames[step.decimated_cycles[i]] = step_decimated_frames[i];
+    }
+
+    if (step.pattern_guessing_changed) {
+        pattern_guessing = redo ? step.new_pattern_guessing : step.old_pattern_guessing;
+        committed_state.pattern_guessing = pattern_guessing;
+    }
+
+#define APPLY_ELEMENT_CHANGES(name) \
+    if (redo) { \
+        applyElementChanges(*name, step.name.removed, step.name.added); \
+        committed_state.name.eraseAndInsert(step.name.removed, step.name.added); \
+    } else { \
+        applyElementChanges(*name, step.name.added, step.name.removed); \
+        committed_state.name.eraseAndInsert(step.name.added, step.name.removed); \
+    }
+
+    APPLY_ELEMENT_CHANGES(presets);
+    APPLY_ELEMENT_CHANGES(combed_frames);
+    APPLY_ELEMENT_CHANGES(frozen_frames);
+    APPLY_ELEMENT_CHANGES(sections);
+    APPLY_ELEMENT_CHANGES(bookmarks);
+
+#undef APPLY_ELEMENT_CHANGES
 
-    sections->clear();
-    for (auto const& s : state.sections)
-        sections->insert(s);
+    if (step.custom_lists_changed) {
+        const CustomListVector &step_custom_lists = redo ? step.new_custom_lists : step.old_custom_lists;
+
+        copyCustomLists(step_custom_lists, *custom_lists);
+        copyCustomLists(step_custom_lists, committed_state.custom_lists);
+    }
 
-    bookmarks->clear();
-    for (auto const& b : state.bookmarks)
-        bookmarks->insert(b);
+    committed_state_memory = committed_state.footprint();
 }
 
 void WobblyProject::commit(std::string description) {
-    UndoStep step = {
-        .description = description,
-        .matches = matches,
-        .decimated_frames = decimated_frames,
-        .pattern_guessing = pattern_guessing,
-
-        .presets = *presets,
-        .custom_lists = *custom_lists,
-        .combed_frames = *combed_frames,
-        .frozen_frames = *frozen_frames,
-        .sections = *sections,
-        .bookmarks = *bookmarks,
-    };
-    for (auto &cl : step.custom_lists) {
-        std::shared_ptr<FrameRangesModel> oldranges = cl.ranges;
-        cl.ranges = std::make_shared<FrameRangesModel>();
+    UndoStep step;
+    step.description = description;
+
+    std::vector<char> &committed_matches = committed_state.matches;
+
+    if (committed_matches.size() != matches.size()) {
+        step.old_matches = committed_matches;
+        step.new_matches = matches.toVector();
+        committed_matches = step.new_matches;
+    } else {
+        auto first = std::mismatch(committed_matches.cbegin(), committed_matches.cend(), matches.cbegin());
+
+        if (first.first != committed_matches.cend()) {
+            auto last = std::mismatch(committed_matches.crbegin(), committed_matches.crend(), std::make_reverse_iterator(matches.cend()));
+
+            size_t start = first.first - committed_matches.cbegin();
+            size_t end = committed_matches.crend() - last.first;
+
+            step.matches_start = start;
+            step.old_matches.assign(committed_matches.cbegin() + start, committed_matches.cbegin() + end);
+            step.new_matches.assign(matches.cbegin() + start, matches.cbegin() + end);
+            std::copy(step.new_matches.cbegin(), step.new_matches.cend(), committed_matches.begin() + start);
+        }
+    }
+
+    committed_state.decimated_frames.resize(decimated_frames.size());
+
+    for (size_t i = 0; i < decimated_frames.size(); i++) {
+        if (committed_state.decimated_frames[i] != decimated_frames[i]) {
+            step.decimated_cycles.push_back(i);
+            step.old_decimated_frames.push_back(committed_state.decimated_frames[i]);
+            step.new_decimated_frames.push_back(decimated_frames[i]);
+            committed_state.decimated_frames[i] = decimated_frames[i];
+        }
+    }
+
+    if (!(committed_state.pattern_guessing == pattern_guessing)) {
+        step.pattern_guessing_changed = true;
+        step.old_pattern_guessing = committed_state.pattern_guessing;
+        step.new_pattern_guessing = pattern_guessing;
+        committed_state.pattern_guessing = pattern_guessing;
+    }
 
-        for (auto const& r : *oldranges)
-            cl.ranges->insert(r);
+#define FIND_ELEMENT_CHANGES(name) \
+    findElementChanges(committed_state.name, *name, step.name); \
+    committed_state.name.eraseAndInsert(step.name.removed, step.name.added);
+
+    FIND_ELEMENT_CHANGES(presets);
+    FIND_ELEMENT_CHANGES(combed_frames);
+    FIND_ELEMENT_CHANGES(frozen_frames);
+    FIND_ELEMENT_CHANGES(sections);
+    FIND_ELEMENT_CHANGES(bookmarks);
+
+#undef FIND_ELEMENT_CHANGES
+
+    if (!areCustomListsEqual(committed_state.custom_lists, *custom_lists)) {
+        step.custom_lists_changed = true;
+        copyCustomLists(committed_state.custom_lists, step.old_custom_lists);
+        copyCustomLists(*custom_lists, step.new_custom_lists);
+        copyCustomLists(*custom_lists, committed_state.custom_lists);
     }
 
-    undo_stack.push_back(step);
+    committed_state_memory = committed_state.footprint();
+
+    // Nothing can be undone past the first step, so it doesn't need to
+    // remember what changed.
+    if (undo_stack.empty())
+        forgetChanges(step);
 
+    undo_memory += step.footprint();
+    undo_stack.push_back(std::move(step));
+
+    for (auto const& r : redo_stack)
+        undo_memory -= r.footprint();
     redo_stack.clear();
 
-    while (undo_stack.size() > undo_steps)
-        undo_stack.pop_front();
+    trimUndoHistory();
 }
 
 void WobblyProject::undo() {
     if (undo_stack.size() <= 1) return;
-    redo_stack.push_back(undo_stack.back());
+    applyUndoStep(undo_stack.back(), false);
+    redo_stack.push_back(std::move(undo_stack.back()));
     undo_stack.pop_back();
-    restoreState(undo_stack.back());
 }
 
 void WobblyProject::redo() {
     if (redo_stack.empty()) return;
-    restoreState(redo_stack.back());
-    undo_stack.push_back(redo_stack.back());
+    applyUndoStep(redo_stack.back(), true);
+    undo_stack.push_back(std::move(redo_stack.back()));
     redo_stack.pop_back();
 }
 
@@ -2971,7 +4165,27 @@ void WobblyProject::setUndoSteps(size_t steps) {
             redo_stack.pop_front();
     }
     while (undo_steps < undo_stack.size() + redo_stack.size())
-        undo_stack.pop_front();
+        popOldestUndoStep();
+
+    undo_memory = 0;
+    for (auto const& u : undo_stack)
+        undo_memory += u.footprint();
+    for (auto const& r : redo_stack)
+        undo_memory += r.footprint();
+
+    trimUndoHistory();
+}
+
+
+void WobblyProject::setUndoMemoryBudget(size_t bytes) {
+    undo_memory_budget = bytes;
+
+    trimUndoHistory();
+}
+
+
+size_t WobblyProject::getUndoMemoryUsage() const {
+    return undo_memory + committed_state_memory;
 }
 
 
@@ -3091,14 +4305,10 @@ int WobblyProject::frameNumberAfterDecimation(int frame) const {
 
     int position_in_cycle = frame % 5;
 
-    int out_frame = cycle_number * 5;
+    int out_frame = decimation_index.prefixSum(cycle_number);
 
-    for (int i = 0; i < cycle_number; i++)
-        out_frame -= decimated_frames[i].size();
-
-    for (int8_t i = 0; i < position_in_cycle; i++)
-        if (!decimated_frames[cycle_number].count(i))
-            out_frame++;
+    // The frames before this one in its cycle, minus the decimated ones.
+    out_frame += position_in_cycle - std::popcount((uint8_t)(decimated_frames[cycle_number] & ((1 << position_in_cycle) - 1)));
 
     if (frame == getNumFrames(PostSource) - 1 && isDecimatedFrame(frame))
         out_frame--;
@@ -3116,13 +4326,18 @@ int WobblyProject::frameNumberBeforeDecimation(int frame) const {
     if (frame >= getNumFrames(PostDecimate))
         frame = getNumFrames(PostDecimate) - 1;
 
-    for (size_t i = 0; i < decimated_frames.size(); i++) {
+    // Skip the cycles whose remaining frames all come before the wanted one.
+    size_t cycle = decimation_index.upperBound(frame);
+
+    if (cycle < decimated_frames.size()) {
+        frame -= decimation_index.prefixSum(cycle);
+
         for (int j = 0; j < 5; j++) {
-            if (!decimated_frames[i].count(j))
+            if (!(decimated_frames[cycle] & (1 << j)))
                 frame--;
 
             if (frame == -1)
-                return i * 5 + j;
+                return cycle * 5 + j;
         }
     }
 
@@ -4251,8 +5466,9 @@ void WobblyProject::decimatedFramesToScript(std::string &script, DecimationFunct
     delete_frames += "src = c.std.DeleteFrames(clip=src, frames=[";
 
     for (size_t i = 0; i < decimated_frames.size(); i++)
-        for (auto it = decimated_frames[i].cbegin(); it != decimated_frames[i].cend(); it++)
-            delete_frames += std::to_string(i * 5 + *it) + ",";
+        for (int j = 0; j < 5; j++)
+            if (decimated_frames[i] & (1 << j))
+                delete_frames += std::to_string(i * 5 + j) + ",";
 
     delete_frames +=
             "])\n"
@@ -4375,7 +5591,7 @@ std::string WobblyProject::generateFinalScript(bool save_source_node, FinalScrip
 
     bool decimation_needed = false;
     for (size_t i = 0; i < decimated_frames.size(); i++)
-        if (decimated_frames[i].size()) {
+        if (decimated_frames[i]) {
             decimation_needed = true;
             break;
         }
@@ -4396,7 +5612,7 @@ std::string WobblyProject::generateFinalScript(bool save_source_node, FinalScrip
 }
 
 
-std::string WobblyProject::generateMainDisplayScript() const {
+std::string WobblyProject::generateMainDisplayScript(bool overrides) const {
     std::string script;
 
     headerToScript(script);
@@ -4405,10 +5621,13 @@ std::string WobblyProject::generateMainDisplayScript() const {
 
     trimToScript(script);
 
-    fieldHintToScript(script);
+    // Without the overrides, the caller is expected to apply them with createOverridesFilter.
+    if (overrides) {
+        fieldHintToScript(script);
 
-    if (frozen_frames->size() && freeze_frames_wanted)
-        freezeFramesToScript(script);
+        if (frozen_frames->size() && freeze_frames_wanted)
+            freezeFramesToScript(script);
+    }
 
     setOutputToScript(script);
 
@@ -4470,15 +5689,23 @@ void WobblyProject::importFromOtherProject(const std::string &path, const Import
 
     other->readProject(path);
 
+    BulkUpdate bulk_update(this);
+
     if (imports.geometry) {
         setUIState(other->getUIState());
         setUIGeometry(other->getUIGeometry());
     }
 
     if (imports.presets || imports.custom_lists) {
+        // Renaming moves the other project's presets around, so don't iterate over them directly.
+        std::vector<std::string> other_preset_names;
+
         const PresetsModel *p = other->getPresetsModel();
-        for (auto it = p->cbegin(); it != p->cend(); it++) {
-            std::string preset_name = it->second.name;
+        for (auto it = p->cbegin(); it != p->cend(); it++)
+            other_preset_names.push_back(it->second.name);
+
+        for (auto const& other_preset_name : other_preset_names) {
+            std::string preset_name = other_preset_name;
 
             bool rename_needed = presetExists(preset_name);
             while (presetExists(preset_name))
@@ -4489,7 +5716,7 @@ void WobblyProject::importFromOtherProject(const std::string &path, const Import
                     preset_name += "_imported";
             }
 
-            other->renamePreset(it->second.name, preset_name); // changes to other aren't saved, so it's okay.
+            other->renamePreset(other_preset_name, preset_name); // changes to other aren't saved, so it's okay.
             if (imports.presets)
                 addPreset(preset_name, other->getPresetContents(preset_name));
         }
@@ -31,20 +31,25 @@ SOFTWARE.
 
 #include <cstdint>
 
+#include <list>
 #include <unordered_map>
 #include <map>
 
 #include <set>
 
 #include <array>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include <QObject>
 
+#include "BlockMaxIndex.h"
 #include "BookmarksModel.h"
 #include "CombedFramesModel.h"
 #include "CustomListsModel.h"
+#include "FenwickTree.h"
+#include "FrameColumn.h"
 #include "FrozenFramesModel.h"
 #include "PresetsModel.h"
 #include "OrphanFieldsModel.h"
@@ -87,19 +92,69 @@ static inline uint8_t matchCharToIndexDMetrics(char match) {
     return 0; // never reaches this
 }
 
-struct UndoStep {
-    std::string description;
+class FrameOverrides;
+
 
+// The undoable parts of the project, as of the last commit, undo or redo.
+struct UndoState {
     std::vector<char> matches;
-    std::vector<std::set<int8_t> > decimated_frames;
+    std::vector<uint8_t> decimated_frames;
     PatternGuessing pattern_guessing;
 
     PresetMap presets;
     CustomListVector custom_lists;
-    std::set<int> combed_frames;
+    CombedFrameSet combed_frames;
     FreezeFrameMap frozen_frames;
     SectionMap sections;
     BookmarkMap bookmarks;
+
+    // Approximate number of bytes used by the state, allocations included.
+    size_t footprint() const;
+};
+
+
+// Elements of a set or map that one commit removed or added.
+// A changed element appears in both, with its old and new value.
+template <typename T>
+struct ElementChanges {
+    std::vector<T> removed;
+    std::vector<T> added;
+};
+
+
+// What one commit changed. Undo puts back the old values, redo the new ones.
+struct UndoStep {
+    std::string description;
+
+    // The matches in [matches_start, matches_start + old_matches.size())
+    // were replaced. If the number of matches changed, the whole arrays
+    // are stored.
+    size_t matches_start = 0;
+    std::vector<char> old_matches;
+    std::vector<char> new_matches;
+
+    std::vector<size_t> decimated_cycles;
+    std::vector<uint8_t> old_decimated_frames; // One per element of decimated_cycles.
+    std::vector<uint8_t> new_decimated_frames;
+
+    bool pattern_guessing_changed = false;
+    PatternGuessing old_pattern_guessing = {};
+    PatternGuessing new_pattern_guessing = {};
+
+    ElementChanges<PresetMap::value_type> presets;
+
+    // Custom lists are few and small, so they are stored whole.
+    bool custom_lists_changed = false;
+    CustomListVector old_custom_lists;
+    CustomListVector new_custom_lists;
+
+    ElementChanges<int> combed_frames;
+    ElementChanges<FreezeFrameMap::value_type> frozen_frames;
+    ElementChanges<SectionMap::value_type> sections;
+    ElementChanges<BookmarkMap::value_type> bookmarks;
+
+    // Approximate number of bytes used by the step, allocations included.
+    size_t footprint() const;
 };
 
 
@@ -145,13 +200,30 @@ class WobblyProject : public QObject {
         std::map<std::string, double> vdecimate_parameters_double;
         std::map<std::string, bool> vdecimate_parameters_bool;
 
-        std::vector<std::array<int16_t, 5> > mics;
-        std::vector<std::array<int32_t, 2> > mmetrics;
-        std::vector<std::array<int32_t, 2> > vmetrics;
-        std::vector<char> matches;
-        std::vector<char> original_matches;
-        std::vector<std::set<int8_t> > decimated_frames; // unordered_set may be sufficient.
-        std::vector<int> decimate_metrics;
+        // The project file last read or written, and the columns file it
+        // refers to, if any. Absolute paths. Saving over that project file
+        // makes its columns file obsolete.
+        std::string project_file;
+        std::string project_columns_file;
+
+        std::string mapped_columns_file; // The columns file the columns below may point into.
+        std::string obsolete_columns_file; // Left behind by the last save because it couldn't be removed.
+
+        // These may point into a mapped columns file.
+        FrameColumn<std::array<int16_t, 5> > mics;
+        FrameColumn<std::array<int32_t, 2> > mmetrics;
+        FrameColumn<std::array<int32_t, 2> > vmetrics;
+        FrameColumn<char> matches;
+        FrameColumn<char> original_matches;
+        std::vector<uint8_t> decimated_frames; // One element per cycle. Bit i is set if frame i of the cycle is decimated.
+        FenwickTree decimation_index; // Number of frames each cycle keeps. Counts every cycle as five frames long.
+        FrameColumn<int32_t> decimate_metrics;
+
+        // What the mic and dmetric searches compare against the minimum, one value per frame.
+        // Built on the first search, then kept up to date by the functions that modify their inputs.
+        mutable BlockMaxIndex<int16_t> mic_search_index;
+        mutable BlockMaxIndex<int32_t> dmetric_search_index;
+        mutable bool search_indices_built = false;
 
         bool is_wobbly; // XXX Maybe only the json writing function needs to know.
 
@@ -167,6 +239,8 @@ class WobblyProject : public QObject {
         SectionsModel *sections;
         BookmarksModel *bookmarks;
 
+        std::shared_ptr<FrameOverrides> frame_overrides;
+
         DMetrics dmetrics = { false, 10 };
         Resize resize = { false, 0, 0, "spline16" };
         Crop crop = {};
@@ -177,22 +251,44 @@ class WobblyProject : public QObject {
         bool freeze_frames_wanted = true;
 
         bool is_modified = false;
+        uint64_t modification_count = 0;
 
         std::list<UndoStep> undo_stack;
         std::list<UndoStep> redo_stack;
         size_t undo_steps;
+        size_t undo_memory_budget = SIZE_MAX; // Bytes.
+        size_t undo_memory = 0; // Sum of the footprints of the steps in undo_stack and redo_stack.
+        UndoState committed_state;
+        size_t committed_state_memory = 0; // Footprint of committed_state, a copy of much of the project.
 
         // Only functions below.
 
         static bool isValidMatchChar(char match);
         void setNumFrames(PositionInFilterChain position, int frames);
 
+        void resetDecimatedFrames();
+        void setDecimatedCycle(size_t cycle, uint8_t dropped);
+
+        int16_t getSearchMic(int frame) const;
+        int32_t getSearchDMetric(int frame) const;
+        void buildSearchIndices() const;
+        void updateSearchIndices(int first, int last);
+
         bool isNameSafeForPython(const std::string &name) const;
         int maybeTranslate(int frame, bool is_end, PositionInFilterChain position) const;
 
         void applyPatternGuessingDecimation(const int section_start, const int section_end, const int first_duplicate, int drop_duplicate);
 
-        void restoreState(UndoStep state);
+        void applyUndoStep(const UndoStep &step, bool redo);
+        void popOldestUndoStep();
+        void trimUndoHistory();
+
+        template <typename JsonWriter>
+        void writeJson(JsonWriter &w, const std::string &columns_file) const;
+
+        void writeColumnsFile(const std::string &path) const;
+        void readColumnsFile(const std::string &project_path, const std::string &path);
+        bool removeColumnsFile(const std::string &path);
 
     public:
         WobblyProject(bool _is_wobbly);
@@ -200,7 +296,7 @@ class WobblyProject : public QObject {
 
         int getNumFrames(PositionInFilterChain position) const;
 
-        void writeProject(const std::string &path, bool compact_project);
+        void writeProject(const std::string &path, bool compact_project, bool binary_columns = false);
         void readProject(const std::string &path);
 
 
@@ -351,8 +447,33 @@ class WobblyProject : public QObject {
         void setFreezeFramesWanted(bool wanted);
 
 
+        const std::shared_ptr<FrameOverrides> &getFrameOverrides() const;
+        // Same return value and range as FrameOverrides::update.
+        bool updateFrameOverrides(int *first_changed, int *last_changed);
+
+
         bool isModified() const;
         void setModified(bool modified);
+        // Increases with every edit, so it can tell if anything changed since a snapshot.
+        uint64_t getModificationCount() const;
+
+        // Copies everything that goes into the project file. Undo history
+        // is left out. The copy can be written from another thread while
+        // this project is being edited. The caller owns the copy.
+        WobblyProject *snapshot() const;
+
+        // Reads any mapped columns into memory.
+        void detachColumns();
+
+        // Called after a snapshot of this project was written, so the next
+        // save knows which columns file the project file refers to. Removes
+        // the old columns file if the snapshot couldn't.
+        void finishSnapshotSave(WobblyProject *snapshot);
+
+        // Past a few rows, the model views see the changes made between
+        // these two calls as one reset instead of row by row. They can nest.
+        void beginBulkUpdate();
+        void endBulkUpdate();
 
 
         // If these are the empty string, there is no undo/redo action available
@@ -363,6 +484,11 @@ class WobblyProject : public QObject {
         void undo();
         void redo();
         void setUndoSteps(size_t steps);
+        // The oldest steps are dropped when the history, together with the
+        // copy of the project kept to find what each commit changed, uses
+        // more memory than this.
+        void setUndoMemoryBudget(size_t bytes);
+        size_t getUndoMemoryUsage() const;
 
 
         int getZoom() const;
@@ -449,7 +575,7 @@ class WobblyProject : public QObject {
         void setOutputToScript(std::string &script) const;
 
         std::string generateFinalScript(bool save_source_node = true, FinalScriptFormat format = {}) const;
-        std::string generateMainDisplayScript() const;
+        std::string generateMainDisplayScript(bool overrides = true) const;
 
         std::string generateTimecodesV1() const;
         std::string generateKeyframesV1() const;
@@ -461,4 +587,24 @@ class WobblyProject : public QObject {
         void modifiedChanged(bool modified);
 };
 
+
+// Keeps a bulk update open until it goes out of scope.
+class BulkUpdate {
+    WobblyProject *project;
+
+public:
+    BulkUpdate(WobblyProject *_project)
+        : project(_project)
+    {
+        project->beginBulkUpdate();
+    }
+
+    ~BulkUpdate() {
+        project->endBulkUpdate();
+    }
+
+    BulkUpdate(const BulkUpdate &) = delete;
+    BulkUpdate &operator=(const BulkUpdate &) = delete;
+};
+
 #endif // WOBBLYPROJECT_H
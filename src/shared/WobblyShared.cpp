@@ -88,27 +88,103 @@ std::map<std::string, FilterState> getRequiredFilterStates(const VSAPI *vsapi, V
     return result;
 }
 
-uint8_t *packRGBFrame(const VSAPI *vsapi, const VSFrame *frame) {
+static void packRowC(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[0] = b[x];
+        dst[1] = g[x];
+        dst[2] = r[x];
+        dst[3] = 0;
+        dst += 4;
+    }
+}
+
+#ifdef ROW_KERNELS_SSE2
+static void packRowSSE2(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, int width) {
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i vr = _mm_loadu_si128((const __m128i *)(r + x));
+        __m128i vg = _mm_loadu_si128((const __m128i *)(g + x));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+
+        __m128i bg_lo = _mm_unpacklo_epi8(vb, vg);
+        __m128i bg_hi = _mm_unpackhi_epi8(vb, vg);
+        __m128i r0_lo = _mm_unpacklo_epi8(vr, zero);
+        __m128i r0_hi = _mm_unpackhi_epi8(vr, zero);
+
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_unpacklo_epi16(bg_lo, r0_lo));
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 16), _mm_unpackhi_epi16(bg_lo, r0_lo));
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 32), _mm_unpacklo_epi16(bg_hi, r0_hi));
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 48), _mm_unpackhi_epi16(bg_hi, r0_hi));
+    }
+
+    packRowC(r + x, g + x, b + x, dst + x * 4, width - x);
+}
+#endif
+
+#ifdef ROW_KERNELS_AVX2
+AVX2_TARGET
+static void packRowAVX2(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32) {
+        __m256i vr = _mm256_loadu_si256((const __m256i *)(r + x));
+        __m256i vg = _mm256_loadu_si256((const __m256i *)(g + x));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + x));
+
+        // The unpacks work within each 128 bit lane, so pixels 0-15 end up
+        // in the low lanes and pixels 16-31 in the high lanes.
+        __m256i bg_lo = _mm256_unpacklo_epi8(vb, vg);
+        __m256i bg_hi = _mm256_unpackhi_epi8(vb, vg);
+        __m256i r0_lo = _mm256_unpacklo_epi8(vr, zero);
+        __m256i r0_hi = _mm256_unpackhi_epi8(vr, zero);
+
+        __m256i p0 = _mm256_unpacklo_epi16(bg_lo, r0_lo); // Pixels 0-3, 16-19.
+        __m256i p1 = _mm256_unpackhi_epi16(bg_lo, r0_lo); // Pixels 4-7, 20-23.
+        __m256i p2 = _mm256_unpacklo_epi16(bg_hi, r0_hi); // Pixels 8-11, 24-27.
+        __m256i p3 = _mm256_unpackhi_epi16(bg_hi, r0_hi); // Pixels 12-15, 28-31.
+
+        _mm256_storeu_si256((__m256i *)(dst + x * 4), _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + x * 4 + 32), _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + x * 4 + 64), _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256((__m256i *)(dst + x * 4 + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+
+    packRowSSE2(r + x, g + x, b + x, dst + x * 4, width - x);
+}
+#endif
+
+std::vector<PackRowKernel> getPackRowKernels() {
+    return getRowKernels<PackRowFunc>(packRowC, SSE2_KERNEL(packRowSSE2), AVX2_KERNEL(packRowAVX2));
+}
+
+void packRGBFrame(const VSAPI *vsapi, const VSFrame *frame, uint8_t *dst, ptrdiff_t dst_stride) {
+    static const PackRowFunc packRow = getPackRowKernels().back().func;
+
     const uint8_t *ptrR = vsapi->getReadPtr(frame, 0);
     const uint8_t *ptrG = vsapi->getReadPtr(frame, 1);
     const uint8_t *ptrB = vsapi->getReadPtr(frame, 2);
     int width = vsapi->getFrameWidth(frame, 0);
     int height = vsapi->getFrameHeight(frame, 0);
     ptrdiff_t stride = vsapi->getStride(frame, 0);
-    uint8_t *frame_data = reinterpret_cast<uint8_t *>(malloc(width * height * 4));
-    uint8_t *fd_ptr = frame_data;
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            fd_ptr[0] = ptrB[x];
-            fd_ptr[1] = ptrG[x];
-            fd_ptr[2] = ptrR[x];
-            fd_ptr[3] = 0;
-            fd_ptr += 4;
-        }
+        packRow(ptrR, ptrG, ptrB, dst, width);
+        dst += dst_stride;
         ptrR += stride;
         ptrG += stride;
         ptrB += stride;
     }
+}
+
+uint8_t *packRGBFrame(const VSAPI *vsapi, const VSFrame *frame) {
+    int width = vsapi->getFrameWidth(frame, 0);
+    int height = vsapi->getFrameHeight(frame, 0);
+    uint8_t *frame_data = reinterpret_cast<uint8_t *>(malloc(width * height * 4));
+    packRGBFrame(vsapi, frame, frame_data, width * 4);
 
     return frame_data;
 }
@@ -24,10 +24,13 @@ SOFTWARE.
 #include <map>
 #include <string>
 #include <cstdint>
+#include <vector>
 
 #include <VSScript4.h>
 #include <VapourSynth4.h>
 
+#include "RowKernels.h"
+
 enum class FilterState
 {
     MissingPlugin,
@@ -39,8 +42,21 @@ typedef const VSSCRIPTAPI *(VS_CC *GetVSScriptAPIFunc)(int version)VS_NOEXCEPT;
 
 std::map<std::string, FilterState> getRequiredFilterStates(const VSAPI *vsapi, VSCore *vscore);
 
+// Interleaves an RGB24 frame into BGRA with the alpha set to 0, as expected by QImage::Format_RGB32.
+// The returned buffer must be released with free().
 uint8_t *packRGBFrame(const VSAPI *vsapi, const VSFrame *frame);
 
+// Same, but writes into dst, which must hold height rows of dst_stride bytes.
+void packRGBFrame(const VSAPI *vsapi, const VSFrame *frame, uint8_t *dst, ptrdiff_t dst_stride);
+
+// Packs one row of width pixels.
+typedef void (*PackRowFunc)(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, int width);
+
+typedef RowKernel<PackRowFunc> PackRowKernel;
+
+// packRGBFrame uses the last one. Only the benchmark needs them.
+std::vector<PackRowKernel> getPackRowKernels();
+
 GetVSScriptAPIFunc fetchVSScript();
 
 #endif // WOBBLYSHARED_H
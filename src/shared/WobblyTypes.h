@@ -28,6 +28,7 @@ SOFTWARE.
 #include <vector>
 
 #include "FrameRangesModel.h"
+#include "SortedVector.h"
 
 enum JSONParameterTypes {
     JSONParamInt,
@@ -39,17 +40,21 @@ struct FreezeFrame {
     int first;
     int last;
     int replacement;
+
+    bool operator==(const FreezeFrame &) const = default;
 };
 
-typedef std::map<int, FreezeFrame> FreezeFrameMap;
+typedef FlatMap<int, FreezeFrame> FreezeFrameMap;
 
 
 struct Preset {
     std::string name; // Must be suitable for use as Python function name.
     std::string contents;
+
+    bool operator==(const Preset &) const = default;
 };
 
-typedef std::map<std::string, Preset> PresetMap;
+typedef FlatMap<std::string, Preset> PresetMap;
 
 
 struct Section {
@@ -59,9 +64,11 @@ struct Section {
     Section(int _start)
         : start(_start)
     { }
+
+    bool operator==(const Section &) const = default;
 };
 
-typedef std::map<int, Section> SectionMap;
+typedef FlatMap<int, Section> SectionMap;
 
 
 struct CustomList {
@@ -85,7 +92,7 @@ struct OrphanField {
     bool decimated;
 };
 
-typedef std::map<int, OrphanField> OrphanFieldMap;
+typedef FlatMap<int, OrphanField> OrphanFieldMap;
 
 struct Resize {
     bool enabled;
@@ -167,6 +174,8 @@ enum Patterns {
 struct FailedPatternGuessing {
     int start;
     int reason;
+
+    bool operator==(const FailedPatternGuessing &) const = default;
 };
 
 typedef std::map<int, FailedPatternGuessing> FailedPatternGuessingMap;
@@ -193,6 +202,8 @@ struct PatternGuessing {
     int decimation;
     int use_patterns;
     FailedPatternGuessingMap failures; // Key is FailedPatternGuessing::start
+
+    bool operator==(const PatternGuessing &) const = default;
 };
 
 
@@ -219,8 +230,10 @@ struct ImportedThings {
 struct Bookmark {
     int frame;
     std::string description;
+
+    bool operator==(const Bookmark &) const = default;
 };
 
-typedef std::map<int, Bookmark> BookmarkMap;
+typedef FlatMap<int, Bookmark> BookmarkMap;
 
 #endif // WOBBLYTYPES_H
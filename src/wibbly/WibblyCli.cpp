@@ -0,0 +1,502 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#include <clocale>
+#include <cstdio>
+#include <functional>
+#include <map>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QTimer>
+
+#define RAPIDJSON_NAMESPACE rj
+#define RAPIDJSON_HAS_STDSTRING 1
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include "WibblyJob.h"
+#include "WibblyJobRunner.h"
+#include "WobblyException.h"
+#include "WobblyShared.h"
+
+
+// wibbly-cli prints one JSON object per line on stdout, for whatever
+// drives it. Everything else goes to stderr.
+class Event {
+    rj::StringBuffer buffer;
+
+public:
+    rj::Writer<rj::StringBuffer> w;
+
+    Event(const char *name)
+        : w(buffer)
+    {
+        w.StartObject();
+        w.Key("event");
+        w.String(name);
+    }
+
+    ~Event() {
+        w.EndObject();
+
+        fprintf(stdout, "%s\n", buffer.GetString());
+        fflush(stdout);
+    }
+};
+
+
+static const std::map<std::string, int> step_names = {
+    { "trim", StepTrim },
+    { "crop", StepCrop },
+    { "field_match", StepFieldMatch },
+    { "interlaced_fades", StepInterlacedFades },
+    { "decimation", StepDecimation },
+    { "scene_changes", StepSceneChanges },
+};
+
+
+static int parseSteps(const QStringList &names) {
+    int steps = StepNone;
+
+    for (const QString &name : names) {
+        if (name.trimmed().isEmpty())
+            continue;
+
+        auto it = step_names.find(name.trimmed().toStdString());
+        if (it == step_names.cend())
+            throw WobblyException("Unknown step '" + name.trimmed().toStdString() + "'.");
+
+        steps |= it->second;
+    }
+
+    return steps;
+}
+
+
+static void readParameters(const rj::Value &json_params, const VIVTCParameters &params, const std::string &where, std::function<void (const std::string &, const rj::Value &, int)> set) {
+    if (!json_params.IsObject())
+        throw WobblyException(where + " must be an object.");
+
+    for (auto it = json_params.MemberBegin(); it != json_params.MemberEnd(); it++) {
+        std::string name = it->name.GetString();
+
+        // The type comes from the defaults, because 12 could just as well be a double.
+        if (params.int_params.count(name)) {
+            if (!it->value.IsInt())
+                throw WobblyException(where + ": '" + name + "' must be an integer.");
+
+            set(name, it->value, VIVTCParamInt);
+        } else if (params.double_params.count(name)) {
+            if (!it->value.IsNumber())
+                throw WobblyException(where + ": '" + name + "' must be a number.");
+
+            set(name, it->value, VIVTCParamDouble);
+        } else if (params.bool_params.count(name)) {
+            if (!it->value.IsBool())
+                throw WobblyException(where + ": '" + name + "' must be true or false.");
+
+            set(name, it->value, VIVTCParamBool);
+        } else {
+            throw WobblyException(where + ": unknown parameter '" + name + "'.");
+        }
+    }
+}
+
+
+// Relative paths are relative to the directory wibbly-cli runs in.
+static WibblyJob readJob(const rj::Value &json_job, const std::string &where) {
+    if (!json_job.IsObject())
+        throw WobblyException(where + " must be an object.");
+
+    WibblyJob job;
+
+    rj::Value::ConstMemberIterator it = json_job.FindMember("input_file");
+    if (it == json_job.MemberEnd() || !it->value.IsString())
+        throw WobblyException(where + ": 'input_file' must be a string.");
+
+    std::string input_file = QFileInfo(QString::fromUtf8(it->value.GetString())).absoluteFilePath().toStdString();
+    job.setInputFile(input_file);
+    job.setSourceFilter(WibblyJob::guessSourceFilter(input_file));
+    job.setOutputFile(input_file + ".wob");
+
+    it = json_job.FindMember("source_filter");
+    if (it != json_job.MemberEnd()) {
+        if (!it->value.IsString())
+            throw WobblyException(where + ": 'source_filter' must be a string.");
+
+        job.setSourceFilter(it->value.GetString());
+    }
+
+    it = json_job.FindMember("output_file");
+    if (it != json_job.MemberEnd()) {
+        if (!it->value.IsString())
+            throw WobblyException(where + ": 'output_file' must be a string.");
+
+        job.setOutputFile(QFileInfo(QString::fromUtf8(it->value.GetString())).absoluteFilePath().toStdString());
+    }
+
+    it = json_job.FindMember("steps");
+    if (it != json_job.MemberEnd()) {
+        if (!it->value.IsArray())
+            throw WobblyException(where + ": 'steps' must be an array.");
+
+        QStringList names;
+        for (rj::SizeType i = 0; i < it->value.Size(); i++) {
+            if (!it->value[i].IsString())
+                throw WobblyException(where + ": 'steps' must contain strings.");
+
+            names.push_back(QString::fromUtf8(it->value[i].GetString()));
+        }
+
+        job.setSteps(parseSteps(names));
+    }
+
+    it = json_job.FindMember("crop");
+    if (it != json_job.MemberEnd()) {
+        const rj::Value &crop = it->value;
+
+        if (!crop.IsArray() || crop.Size() != 4 || !crop[0].IsInt() || !crop[1].IsInt() || !crop[2].IsInt() || !crop[3].IsInt())
+            throw WobblyException(where + ": 'crop' must be an array of four integers: left, top, right, bottom.");
+
+        job.setCrop(crop[0].GetInt(), crop[1].GetInt(), crop[2].GetInt(), crop[3].GetInt());
+    }
+
+    it = json_job.FindMember("trims");
+    if (it != json_job.MemberEnd()) {
+        if (!it->value.IsArray())
+            throw WobblyException(where + ": 'trims' must be an array.");
+
+        for (rj::SizeType i = 0; i < it->value.Size(); i++) {
+            const rj::Value &trim = it->value[i];
+
+            if (!trim.IsArray() || trim.Size() != 2 || !trim[0].IsInt() || !trim[1].IsInt())
+                throw WobblyException(where + ": every trim must be an array of two integers: first frame, last frame.");
+
+            job.addTrim(trim[0].GetInt(), trim[1].GetInt());
+        }
+    }
+
+    it = json_job.FindMember("vfm");
+    if (it != json_job.MemberEnd())
+        readParameters(it->value, job.getVFMParameters(), where + ": 'vfm'", [&job] (const std::string &name, const rj::Value &value, int type) {
+            if (type == VIVTCParamInt)
+                job.setVFMParameter(name, value.GetInt());
+            else if (type == VIVTCParamDouble)
+                job.setVFMParameter(name, value.GetDouble());
+            else
+                job.setVFMParameter(name, value.GetBool());
+        });
+
+    it = json_job.FindMember("vdecimate");
+    if (it != json_job.MemberEnd())
+        readParameters(it->value, job.getVDecimateParameters(), where + ": 'vdecimate'", [&job] (const std::string &name, const rj::Value &value, int type) {
+            if (type == VIVTCParamInt)
+                job.setVDecimateParameter(name, value.GetInt());
+            else if (type == VIVTCParamDouble)
+                job.setVDecimateParameter(name, value.GetDouble());
+            else
+                job.setVDecimateParameter(name, value.GetBool());
+        });
+
+    it = json_job.FindMember("dmetrics");
+    if (it != json_job.MemberEnd()) {
+        const rj::Value &dmetrics = it->value;
+
+        if (!dmetrics.IsObject())
+            throw WobblyException(where + ": 'dmetrics' must be an object.");
+
+        bool enabled = job.getDMetrics().enabled;
+        int nt = job.getDMetrics().nt;
+
+        rj::Value::ConstMemberIterator member = dmetrics.FindMember("enabled");
+        if (member != dmetrics.MemberEnd()) {
+            if (!member->value.IsBool())
+                throw WobblyException(where + ": 'dmetrics.enabled' must be true or false.");
+
+            enabled = member->value.GetBool();
+        }
+
+        member = dmetrics.FindMember("nt");
+        if (member != dmetrics.MemberEnd()) {
+            if (!member->value.IsInt())
+                throw WobblyException(where + ": 'dmetrics.nt' must be an integer.");
+
+            nt = member->value.GetInt();
+        }
+
+        job.setDMetrics(enabled, nt);
+    }
+
+    it = json_job.FindMember("fades_threshold");
+    if (it != json_job.MemberEnd()) {
+        if (!it->value.IsNumber())
+            throw WobblyException(where + ": 'fades_threshold' must be a number.");
+
+        job.setFadesThreshold(it->value.GetDouble());
+    }
+
+    return job;
+}
+
+
+// The file contains { "jobs": [ ... ] }.
+static void readJobsFile(const QString &path, std::vector<WibblyJob> &jobs) {
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+        throw WobblyException("Couldn't open jobs file '" + path.toStdString() + "'. Error message: " + file.errorString().toStdString());
+
+    QByteArray contents = file.readAll();
+
+    rj::Document json_jobs;
+    json_jobs.Parse(contents.constData(), contents.size());
+
+    if (json_jobs.HasParseError())
+        throw WobblyException("Failed to parse jobs file '" + path.toStdString() + "' at byte " + std::to_string(json_jobs.GetErrorOffset()) + ": " + rj::GetParseError_En(json_jobs.GetParseError()));
+
+    if (!json_jobs.IsObject() || !json_jobs.HasMember("jobs") || !json_jobs["jobs"].IsArray())
+        throw WobblyException(path.toStdString() + ": the JSON document must be an object with a 'jobs' array.");
+
+    const rj::Value &json_array = json_jobs["jobs"];
+
+    for (rj::SizeType i = 0; i < json_array.Size(); i++)
+        jobs.push_back(readJob(json_array[i], path.toStdString() + ": job number " + std::to_string(i + 1)));
+}
+
+
+static const char *messageTypeName(int msgType) {
+    if (msgType == mtFatal)
+        return "fatal";
+    else if (msgType == mtCritical)
+        return "critical";
+    else if (msgType == mtWarning)
+        return "warning";
+    else if (msgType == mtInformation)
+        return "information";
+    else
+        return "unknown";
+}
+
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    app.setApplicationName("wibbly-cli");
+    app.setApplicationVersion(PACKAGE_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Gathers metrics and creates Wobbly project files, without a user interface.\n"
+                                                    "Progress is reported as one JSON object per line on stdout."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QStringLiteral("jobs"), QStringLiteral("JSON files with the jobs to run: { \"jobs\": [ { \"input_file\": ..., ... } ] }."), QStringLiteral("[jobs...]"));
+
+    QCommandLineOption input_option({ "i", "input" }, QStringLiteral("Add a job for this video, with the default parameters."), QStringLiteral("file"));
+    QCommandLineOption output_option({ "o", "output" }, QStringLiteral("Project file for the job added with --input. Default: the input file plus '.wob'."), QStringLiteral("file"));
+    QCommandLineOption source_filter_option(QStringLiteral("source-filter"), QStringLiteral("Source filter for the job added with --input."), QStringLiteral("filter"));
+    QCommandLineOption steps_option(QStringLiteral("steps"), QStringLiteral("Comma-separated steps for the job added with --input: trim, crop, field_match, interlaced_fades, decimation, scene_changes. Default: all of them."), QStringLiteral("steps"));
+    QCommandLineOption concurrent_jobs_option({ "j", "jobs" }, QStringLiteral("Jobs running at the same time. Default: 1."), QStringLiteral("count"), QStringLiteral("1"));
+    QCommandLineOption frame_requests_option(QStringLiteral("requests"), QStringLiteral("Frames requested at once by all the jobs together. Default: the number of CPU threads."), QStringLiteral("count"), QString::number(QThread::idealThreadCount()));
+    QCommandLineOption job_frame_requests_option(QStringLiteral("job-requests"), QStringLiteral("Frames requested at once by one job. Default: the number of CPU threads."), QStringLiteral("count"), QString::number(QThread::idealThreadCount()));
+    QCommandLineOption chunks_option(QStringLiteral("chunks"), QStringLiteral("Split long jobs into this many parts, processed at the same time. Default: 1."), QStringLiteral("count"), QStringLiteral("1"));
+    QCommandLineOption cache_option(QStringLiteral("cache-size"), QStringLiteral("Maximum VapourSynth cache size, in MiB, shared between the running jobs. Default: 4096."), QStringLiteral("MiB"), QStringLiteral("4096"));
+    QCommandLineOption progress_option(QStringLiteral("progress-interval"), QStringLiteral("Milliseconds between progress events. Default: 1000."), QStringLiteral("ms"), QStringLiteral("1000"));
+    QCommandLineOption compact_option(QStringLiteral("compact"), QStringLiteral("Create compact project files."));
+    QCommandLineOption binary_columns_option(QStringLiteral("binary-columns"), QStringLiteral("Store per-frame data in a binary file next to the project."));
+    QCommandLineOption relative_paths_option(QStringLiteral("relative-paths"), QStringLiteral("Use relative paths in project files."));
+
+    parser.addOptions({
+        input_option,
+        output_option,
+        source_filter_option,
+        steps_option,
+        concurrent_jobs_option,
+        frame_requests_option,
+        job_frame_requests_option,
+        chunks_option,
+        cache_option,
+        progress_option,
+        compact_option,
+        binary_columns_option,
+        relative_paths_option,
+    });
+
+    parser.process(app);
+
+    std::vector<WibblyJob> jobs;
+
+    int concurrent_jobs;
+    int frame_requests;
+    int job_frame_requests;
+    int job_chunks;
+    int64_t max_cache_size;
+    int progress_interval;
+
+    try {
+        const QStringList files = parser.positionalArguments();
+        for (const QString &file : files)
+            readJobsFile(file, jobs);
+
+        if (parser.isSet(input_option)) {
+            std::string input_file = QFileInfo(parser.value(input_option)).absoluteFilePath().toStdString();
+
+            jobs.emplace_back();
+            WibblyJob &job = jobs.back();
+
+            job.setInputFile(input_file);
+            job.setSourceFilter(parser.isSet(source_filter_option) ? parser.value(source_filter_option).toStdString() : WibblyJob::guessSourceFilter(input_file));
+            job.setOutputFile(parser.isSet(output_option) ? QFileInfo(parser.value(output_option)).absoluteFilePath().toStdString() : input_file + ".wob");
+
+            if (parser.isSet(steps_option))
+                job.setSteps(parseSteps(parser.value(steps_option).split(',')));
+        }
+
+        if (jobs.empty())
+            throw WobblyException("No jobs. Pass a jobs file or --input.");
+
+        auto readPositive = [&parser] (const QCommandLineOption &option) {
+            bool ok;
+            int value = parser.value(option).toInt(&ok);
+            if (!ok || value < 1)
+                throw WobblyException("--" + option.names().last().toStdString() + " must be a positive integer.");
+            return value;
+        };
+
+        concurrent_jobs = readPositive(concurrent_jobs_option);
+        frame_requests = readPositive(frame_requests_option);
+        job_frame_requests = readPositive(job_frame_requests_option);
+        job_chunks = readPositive(chunks_option);
+        max_cache_size = (int64_t)readPositive(cache_option) * 1024 * 1024;
+        progress_interval = readPositive(progress_option);
+    } catch (WobblyException &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    GetVSScriptAPIFunc newVSScriptAPI;
+    const VSSCRIPTAPI *vssapi = nullptr;
+
+    try {
+        newVSScriptAPI = fetchVSScript();
+
+        std::string oldlocale(setlocale(LC_ALL, NULL));
+        vssapi = newVSScriptAPI(VSSCRIPT_API_VERSION);
+        setlocale(LC_ALL, oldlocale.c_str());
+
+        if (!vssapi)
+            throw WobblyException("Fatal error: failed to initialise VSScript. Your VapourSynth installation is probably broken. Python probably couldn't 'import vapoursynth'.");
+
+        if (!vssapi->getVSAPI(VAPOURSYNTH_API_VERSION))
+            throw WobblyException("Fatal error: failed to acquire VapourSynth API struct. Did you update the VapourSynth library but not the Python module (or the other way around)?");
+    } catch (WobblyException &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 3;
+    }
+
+
+    WibblyJobQueue queue(vssapi, jobs, concurrent_jobs, parser.isSet(compact_option), parser.isSet(binary_columns_option), parser.isSet(relative_paths_option), max_cache_size, frame_requests, job_frame_requests, job_chunks);
+
+    QElapsedTimer elapsed_timer;
+    elapsed_timer.start();
+
+    QTimer progress_timer;
+    progress_timer.setInterval(progress_interval);
+
+    QObject::connect(&progress_timer, &QTimer::timeout, [&queue] () {
+        for (const WibblyJobRunner *runner : queue.getRunningJobs()) {
+            Event e("progress");
+            e.w.Key("job");
+            e.w.Int(runner->getJobIndex());
+            e.w.Key("frames_done");
+            e.w.Int(runner->getFramesDone());
+            e.w.Key("frames_total");
+            e.w.Int(runner->getFramesTotal());
+            e.w.Key("fps");
+            e.w.Double(runner->getFramesPerSecond());
+        }
+    });
+
+    QObject::connect(&queue, &WibblyJobQueue::logMessage, [] (int job_index, int msgType, const QString &msg) {
+        fprintf(stderr, "Job %d: %s: %s\n", job_index, messageTypeName(msgType), msg.toUtf8().constData());
+    });
+
+    QObject::connect(&queue, &WibblyJobQueue::jobStarted, [&jobs] (const WibblyJobRunner *runner) {
+        int job_index = runner->getJobIndex();
+
+        Event e("started");
+        e.w.Key("job");
+        e.w.Int(job_index);
+        e.w.Key("input_file");
+        e.w.String(jobs[job_index].getInputFile());
+        e.w.Key("output_file");
+        e.w.String(jobs[job_index].getOutputFile());
+        e.w.Key("frames_total");
+        e.w.Int(runner->getFramesTotal());
+    });
+
+    QObject::connect(&queue, &WibblyJobQueue::jobFinished, [&jobs] (int job_index, const WibblyJobRunner *runner, const QString &error) {
+        Event e("finished");
+        e.w.Key("job");
+        e.w.Int(job_index);
+        e.w.Key("output_file");
+        e.w.String(jobs[job_index].getOutputFile());
+        if (runner) {
+            e.w.Key("frames");
+            e.w.Int(runner->getFramesTotal());
+            e.w.Key("fps");
+            e.w.Double(runner->getFramesPerSecond());
+        }
+        e.w.Key("error");
+        if (error.isEmpty())
+            e.w.Null();
+        else
+            e.w.String(error.toStdString());
+    });
+
+    QObject::connect(&queue, &WibblyJobQueue::allFinished, [&] () {
+        progress_timer.stop();
+
+        {
+            Event e("done");
+            e.w.Key("jobs");
+            e.w.Int((int)jobs.size());
+            e.w.Key("failed");
+            e.w.Int(queue.getJobsFailed());
+            e.w.Key("seconds");
+            e.w.Double(elapsed_timer.elapsed() / 1000.0);
+        }
+
+        QCoreApplication::exit(queue.getJobsFailed() ? 1 : 0);
+    });
+
+    progress_timer.start();
+
+    // Inside the event loop, so exit works.
+    QTimer::singleShot(0, &queue, &WibblyJobQueue::start);
+
+    return app.exec();
+}
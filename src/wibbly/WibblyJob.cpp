@@ -86,6 +86,18 @@ void WibblyJob::setSourceFilter(const std::string &filter) {
 }
 
 
+std::string WibblyJob::guessSourceFilter(const std::string &path) {
+    std::string extension = path.substr(path.rfind('.') + 1);
+
+    if (extension == "dgi")
+        return "dgdecodenv.DGSource";
+    else if (extension == "d2v")
+        return "d2v.Source";
+    else
+        return "bs.VideoSource";
+}
+
+
 std::string WibblyJob::getOutputFile() const {
     return output_file;
 }
@@ -157,6 +169,11 @@ void WibblyJob::setDMetrics(bool enabled, int nt) {
 }
 
 
+const VIVTCParameters &WibblyJob::getVFMParameters() const {
+    return vfm;
+}
+
+
 int WibblyJob::getVFMParameterInt(const std::string &name) const {
     return vfm.int_params.at(name);
 }
@@ -187,6 +204,11 @@ void WibblyJob::setVFMParameter(const std::string &name, bool value) {
 }
 
 
+const VIVTCParameters &WibblyJob::getVDecimateParameters() const {
+    return vdecimate;
+}
+
+
 int WibblyJob::getVDecimateParameterInt(const std::string &name) const {
     return vdecimate.int_params.at(name);
 }
@@ -318,24 +340,13 @@ void WibblyJob::fieldMatchToScript(std::string &script) const {
 
 
 void WibblyJob::interlacedFadesToScript(std::string &script) const {
+    // wibbly_field_difference is a native filter, passed to the script by whoever evaluates it.
+    // Depending on the VapourSynth version, functions return either the clip or a dict.
     script +=
-            "def copyProp(n, f):\n"
-            "    fout = f[0].copy()\n"
-            "    fout.props.WibblyFieldDifference = abs(f[0].props.WibblyEvenAverage - f[1].props.WibblyOddAverage)\n"
-            "    return fout\n"
-            "\n"
-            "separated = c.std.SeparateFields(clip=src, tff=True)\n"
-
-            "even = c.std.SelectEvery(clip=separated, cycle=2, offsets=0)\n"
-            "even = c.std.PlaneStats(clipa=even, plane=0, prop='WibblyEven')\n"
-
-            "odd = c.std.SelectEvery(clip=separated, cycle=2, offsets=1)\n"
-            "odd = c.std.PlaneStats(clipa=odd, plane=0, prop='WibblyOdd')\n"
-
-            "even = c.std.ModifyFrame(clip=even, clips=[even, odd], selector=copyProp)\n"
-            "src = c.std.Interleave(clips=[even, odd])\n"
-            "src = c.std.DoubleWeave(clip=src, tff=True)\n"
-            "src = c.std.SelectEvery(clip=src, cycle=2, offsets=0)\n\n";
+            "src = wibbly_field_difference(clip=src)\n"
+            "if isinstance(src, dict):\n"
+            "    src = src['clip']\n"
+            "\n";
 }
 
 
@@ -378,6 +389,11 @@ void WibblyJob::decimationToScript(std::string &script) const {
 }
 
 
+void WibblyJob::chunkToScript(std::string &script, int first, int last) const {
+    script += "src = src[" + std::to_string(first) + ":" + std::to_string(last) + "]\n\n";
+}
+
+
 void WibblyJob::sceneChangesToScript(std::string &script) const {
     script += "src = c.scxvid.Scxvid(clip=src, use_slices=True)\n\n";
 }
@@ -388,7 +404,7 @@ void WibblyJob::setOutputToScript(std::string &script) const {
 }
 
 
-std::string WibblyJob::generateFinalScript() const {
+std::string WibblyJob::generateMetricsScript(bool chunk, int first, int last) const {
     std::string script;
 
     headerToScript(script);
@@ -410,6 +426,10 @@ std::string WibblyJob::generateFinalScript() const {
     if (steps & StepDecimation)
         decimationToScript(script);
 
+    // Everything before Scxvid works on each frame on its own, so the clip can be cut here.
+    if (chunk)
+        chunkToScript(script, first, last);
+
     if (steps & StepSceneChanges)
         sceneChangesToScript(script);
 
@@ -419,6 +439,16 @@ std::string WibblyJob::generateFinalScript() const {
 }
 
 
+std::string WibblyJob::generateFinalScript() const {
+    return generateMetricsScript(false, 0, 0);
+}
+
+
+std::string WibblyJob::generateChunkScript(int first, int last) const {
+    return generateMetricsScript(true, first, last);
+}
+
+
 std::string WibblyJob::generateDisplayScript() const {
     std::string script;
 
@@ -446,3 +476,33 @@ std::string WibblyJob::generateDisplayScript() const {
     return script;
 }
 
+
+void WibblyJob::configureProject(WobblyProject *project, int num_frames) const {
+    for (auto it = trims.cbegin(); it != trims.cend(); it++)
+        project->addTrim(it->second.first, it->second.last);
+
+    if (!trims.size())
+        project->addTrim(0, num_frames - 1);
+
+    if (steps & StepFieldMatch) {
+        for (auto it = vfm.int_params.cbegin(); it != vfm.int_params.cend(); it++)
+            project->setVFMParameter(it->first, it->second);
+
+        for (auto it = vfm.double_params.cbegin(); it != vfm.double_params.cend(); it++)
+            project->setVFMParameter(it->first, it->second);
+
+        for (auto it = vfm.bool_params.cbegin(); it != vfm.bool_params.cend(); it++)
+            project->setVFMParameter(it->first, it->second);
+    }
+
+    if (steps & StepDecimation) {
+        for (auto it = vdecimate.int_params.cbegin(); it != vdecimate.int_params.cend(); it++)
+            project->setVDecimateParameter(it->first, it->second);
+
+        for (auto it = vdecimate.double_params.cbegin(); it != vdecimate.double_params.cend(); it++)
+            project->setVDecimateParameter(it->first, it->second);
+
+        for (auto it = vdecimate.bool_params.cbegin(); it != vdecimate.bool_params.cend(); it++)
+            project->setVDecimateParameter(it->first, it->second);
+    }
+}
@@ -39,6 +39,13 @@ enum MetricsGatheringSteps {
 };
 
 
+enum VIVTCParameterTypes {
+    VIVTCParamInt,
+    VIVTCParamDouble,
+    VIVTCParamBool
+};
+
+
 struct VIVTCParameters {
     std::unordered_map<std::string, int> int_params;
     std::unordered_map<std::string, double> double_params;
@@ -77,9 +84,12 @@ class WibblyJob {
     void interlacedFadesToScript(std::string &script) const;
     void framePropsToScript(std::string &script) const;
     void decimationToScript(std::string &script) const;
+    void chunkToScript(std::string &script, int first, int last) const;
     void sceneChangesToScript(std::string &script) const;
     void setOutputToScript(std::string &script) const;
 
+    std::string generateMetricsScript(bool chunk, int first, int last) const;
+
 public:
     WibblyJob();
 
@@ -91,6 +101,9 @@ public:
     std::string getSourceFilter() const;
     void setSourceFilter(const std::string &filter);
 
+    // Picks the source filter by the extension.
+    static std::string guessSourceFilter(const std::string &path);
+
 
     std::string getOutputFile() const;
     void setOutputFile(const std::string &path);
@@ -112,6 +125,7 @@ public:
     void setDMetrics(bool enabled, int nt);
 
 
+    const VIVTCParameters &getVFMParameters() const;
     int getVFMParameterInt(const std::string &name) const;
     double getVFMParameterDouble(const std::string &name) const;
     bool getVFMParameterBool(const std::string &name) const;
@@ -120,6 +134,7 @@ public:
     void setVFMParameter(const std::string &name, bool value);
 
 
+    const VIVTCParameters &getVDecimateParameters() const;
     int getVDecimateParameterInt(const std::string &name) const;
     double getVDecimateParameterDouble(const std::string &name) const;
     bool getVDecimateParameterBool(const std::string &name) const;
@@ -133,7 +148,13 @@ public:
 
 
     std::string generateFinalScript() const;
+    // Only frames first to last - 1 of the final script, numbered from 0. Scxvid starts at first.
+    std::string generateChunkScript(int first, int last) const;
     std::string generateDisplayScript() const;
+
+
+    // Copies the trims and the VFM and VDecimate parameters into the project.
+    void configureProject(WobblyProject *project, int num_frames) const;
 };
 
 #endif // WIBBLYJOB_H
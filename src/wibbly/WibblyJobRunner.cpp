@@ -0,0 +1,1135 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <QFileInfo>
+
+#include "WibblyJobRunner.h"
+#include "WobblyException.h"
+#include "WobblyFilters.h"
+
+
+// Shorter chunks aren't worth their own core.
+#define MINIMUM_CHUNK_LENGTH 10000
+
+// How far back a chunk starts to line up Scxvid with the previous chunk.
+#define SCENE_CHANGE_OVERLAP 1000
+
+#define CHECKPOINT_FILE_VERSION 1
+
+// The records are written when this many pile up, or this many milliseconds pass.
+#define CHECKPOINT_RECORDS 1000
+#define CHECKPOINT_INTERVAL 10000
+
+
+// The checkpoint file is a CheckpointFileHeader followed by CheckpointRecords,
+// in the order the frames were done. Only the machine that wrote it is
+// expected to read it.
+struct CheckpointFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t record_size;
+    int32_t num_frames;
+    int32_t num_chunks;
+    uint32_t reserved;
+    uint64_t script_hash;
+};
+
+
+static const char checkpoint_file_magic[8] = { 'W', 'I', 'B', 'C', 'K', 'P', 'T', 0 };
+static const uint32_t checkpoint_file_byte_order = 0x01020304;
+
+
+FrameBudget::FrameBudget(int size)
+    : available(size)
+{
+
+}
+
+
+bool FrameBudget::acquire(WibblyJobRunner *runner) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (available > 0) {
+        available--;
+        return true;
+    }
+
+    if (std::find(waiting.cbegin(), waiting.cend(), runner) == waiting.cend())
+        waiting.push_back(runner);
+
+    return false;
+}
+
+
+void FrameBudget::release() {
+    WibblyJobRunner *runner = nullptr;
+    int chunk_index = 0;
+    int n = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Runners that don't want any more frames are simply dropped from the queue.
+        while (n < 0 && !waiting.empty()) {
+            runner = waiting.front();
+            waiting.pop_front();
+
+            n = runner->reserveFrame(chunk_index);
+        }
+
+        if (n < 0) {
+            available++;
+            return;
+        }
+    }
+
+    // The reservation keeps the runner alive until the frame is done.
+    runner->requestFrame(chunk_index, n);
+}
+
+
+void FrameBudget::forget(WibblyJobRunner *runner) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    waiting.erase(std::remove(waiting.begin(), waiting.end(), runner), waiting.end());
+}
+
+
+void VS_CC jobMessageHandler(int msgType, const char *msg, void *userData) {
+    if (msgType == mtDebug)
+        return;
+
+    WibblyJobRunner *runner = (WibblyJobRunner *)userData;
+
+    emit runner->logMessage(msgType, QString(msg));
+}
+
+
+void VS_CC jobFrameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg) {
+    WibblyJobRunner::Chunk *chunk = (WibblyJobRunner::Chunk *)userData;
+
+    chunk->runner->frameDone(chunk, f, chunk->first + n, errorMsg);
+}
+
+
+// FNV-1a, which doesn't change between runs like std::hash may.
+static uint64_t hashString(const std::string &string) {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (unsigned char c : string) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+
+static void atomicMin(std::atomic<int> &value, int n) {
+    int old_value = value;
+    while (n < old_value && !value.compare_exchange_weak(old_value, n))
+        ;
+}
+
+
+WibblyJobRunner::Chunk::~Chunk() {
+    if (vsnode)
+        runner->vsapi->freeNode(vsnode);
+
+    if (vsscript)
+        runner->vssapi->freeScript(vsscript);
+}
+
+
+uint8_t WibblyJobRunner::Chunk::getState(int n) const {
+    if (n < first || n >= last)
+        return FrameNotDone;
+
+    return states[n - first];
+}
+
+
+WibblyJobRunner::WibblyJobRunner(const VSSCRIPTAPI *_vssapi, const WibblyJob &_job, int _job_index, bool _compact_project, bool _binary_columns, bool _relative_paths, int64_t _max_cache_size, FrameBudget *_budget, int _max_requests, int _max_chunks)
+    : vssapi(_vssapi)
+    , vsapi(_vssapi->getVSAPI(VAPOURSYNTH_API_VERSION))
+    , job(_job)
+    , job_index(_job_index)
+    , compact_project(_compact_project)
+    , binary_columns(_binary_columns)
+    , relative_paths(_relative_paths)
+    , max_cache_size(_max_cache_size)
+    , max_chunks(std::max(1, _max_chunks))
+    , budget(_budget)
+    , max_requests(std::max(1, _max_requests))
+    , frames_done(0)
+    , requests_in_flight(0)
+    , outstanding(0)
+    , aborted(false)
+    , completed(false)
+    , done(false)
+{
+
+}
+
+
+WibblyJobRunner::~WibblyJobRunner() {
+    cancel();
+
+    budget->forget(this);
+
+    {
+        std::unique_lock<std::mutex> lock(outstanding_mutex);
+        while (outstanding)
+            outstanding_condition.wait(lock);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(checkpoint_mutex);
+        writeCheckpointRecords();
+        checkpoint_file.close();
+    }
+
+    delete project;
+
+    chunks.clear();
+}
+
+
+void WibblyJobRunner::evaluateScript(Chunk *chunk, const std::string &script) {
+    std::string description = chunk->index ? "chunk number " + std::to_string(chunk->index + 1) + " of job number " + std::to_string(job_index + 1) : "job number " + std::to_string(job_index + 1);
+
+    chunk->vscore = vsapi->createCore(0);
+    if (!chunk->vscore)
+        throw WobblyException("Failed to create VapourSynth core object for " + description + ".");
+
+    vsapi->addLogHandler(jobMessageHandler, nullptr, (void *)this, chunk->vscore);
+
+    // Every job has its own cache, so they share the memory between them.
+    vsapi->setMaxCacheSize(max_cache_size, chunk->vscore);
+
+    chunk->vsscript = vssapi->createScript(chunk->vscore);
+    if (!chunk->vsscript) {
+        vsapi->freeCore(chunk->vscore);
+
+        throw WobblyException("Failed to create VSScript object for " + description + ".");
+    }
+
+    // The script reuses the last source clip if the file is the same, but a fresh environment has no last file yet.
+    VSMap *variables = vsapi->createMap();
+    vsapi->mapSetData(variables, "wibbly_last_input_file", "", -1, dtUtf8, maReplace);
+    vsapi->mapConsumeFunction(variables, "wibbly_field_difference", createFieldDifferenceFunction(vsapi, chunk->vscore), maReplace);
+    vssapi->setVariables(chunk->vsscript, variables);
+    vsapi->freeMap(variables);
+
+    vssapi->evalSetWorkingDir(chunk->vsscript, 1);
+    if (vssapi->evaluateBuffer(chunk->vsscript, script.c_str(), job.getInputFile().c_str())) {
+        std::string error = vssapi->getError(chunk->vsscript);
+        // The traceback is mostly unnecessary noise.
+        size_t traceback = error.find("Traceback");
+        if (traceback != std::string::npos)
+            error.insert(traceback, 1, '\n');
+
+        throw WobblyException("Failed to evaluate final script for " + description + ". Error message:\n" + error);
+    }
+
+    chunk->vsnode = vssapi->getOutputNode(chunk->vsscript, 0);
+    if (!chunk->vsnode)
+        throw WobblyException("Final script for " + description + " evaluated successfully, but no node found at output index 0.");
+}
+
+
+// chunks[0] has the whole clip when this is called.
+void WibblyJobRunner::createChunks() {
+    bool scene_changes = job.getSteps() & StepSceneChanges;
+
+    std::vector<CheckpointRecord> records;
+
+    // A job started again keeps the chunks it had, because the checkpoint's frames depend on them.
+    int num_chunks = readCheckpoint(records);
+    if (!num_chunks)
+        num_chunks = std::max(1, std::min(max_chunks, num_frames / MINIMUM_CHUNK_LENGTH));
+
+    openCheckpoint(num_chunks, records.size());
+
+    frame_metrics.resize(num_frames);
+    frame_metrics_done = std::make_unique<std::atomic<bool>[]>(num_frames);
+    for (int n = 0; n < num_frames; n++)
+        frame_metrics_done[n] = false;
+
+    // Multiples of 5, so the chunks don't cut VDecimate's cycles.
+    std::vector<int> starts;
+    for (int i = 0; i < num_chunks; i++)
+        starts.push_back((int)((int64_t)num_frames * i / num_chunks / 5 * 5));
+    starts.push_back(num_frames);
+
+    std::vector<std::unique_ptr<Chunk>> layout;
+
+    for (int i = 0; i < num_chunks; i++) {
+        layout.push_back(std::make_unique<Chunk>());
+
+        Chunk *chunk = layout[i].get();
+        chunk->runner = this;
+        chunk->checkpoint_index = i;
+        chunk->start = starts[i];
+        chunk->end = starts[i + 1];
+
+        if (scene_changes && i) {
+            chunk->first = std::max(starts[i] - SCENE_CHANGE_OVERLAP, starts[i] - (starts[i] - starts[i - 1]) / 4);
+            chunk->takeover = INT_MAX;
+        } else {
+            chunk->first = chunk->start;
+            chunk->takeover = chunk->start;
+        }
+
+        if (scene_changes && i + 2 <= num_chunks)
+            chunk->last = starts[i + 2];
+        else
+            chunk->last = chunk->end;
+
+        chunk->next_frame = chunk->first;
+        chunk->requests_in_flight = 0;
+
+        chunk->states = std::make_unique<std::atomic<uint8_t>[]>(num_frames - chunk->first);
+        for (int n = 0; n < num_frames - chunk->first; n++)
+            chunk->states[n] = FrameNotDone;
+    }
+
+    // The first record of a frame wins.
+    for (const CheckpointRecord &record : records) {
+        if (record.chunk < 0 || record.chunk >= num_chunks)
+            continue;
+
+        Chunk *chunk = layout[record.chunk].get();
+        int n = record.frame;
+
+        // A chunk may have gone on past last.
+        if (n < chunk->first || n >= num_frames || chunk->states[n - chunk->first] != FrameNotDone)
+            continue;
+
+        chunk->states[n - chunk->first] = record.metrics.scene_change ? FrameSceneChange : FrameDone;
+
+        if (!frame_metrics_done[n].exchange(true)) {
+            frame_metrics[n] = record.metrics;
+            frames_resumed++;
+        }
+    }
+
+    // Only the frames done in a row are kept, because Scxvid can't skip any.
+    std::vector<int> lasts;
+
+    for (auto &chunk : layout) {
+        lasts.push_back(chunk->last);
+
+        int n = chunk->first;
+        while (n < num_frames && chunk->states[n - chunk->first] != FrameNotDone)
+            n++;
+
+        chunk->last = n;
+
+        for (; n < num_frames; n++)
+            chunk->states[n - chunk->first] = FrameNotDone;
+    }
+
+    for (int i = 1; i < num_chunks && scene_changes; i++)
+        layout[i]->takeover = findTakeover(layout[i - 1].get(), layout[i].get());
+
+    // Every chunk with frames from the checkpoint keeps them, and a new
+    // chunk continues from there, unless nothing is missing. A chunk the
+    // next one didn't line up with yet has to go on to the end if need be.
+    std::vector<std::unique_ptr<Chunk>> new_chunks;
+
+    for (int i = 0; i < num_chunks; i++) {
+        Chunk *chunk = layout[i].get();
+
+        int resume = chunk->last;
+        int limit = num_frames;
+        if (i + 1 < num_chunks && layout[i + 1]->takeover != INT_MAX)
+            limit = std::min(layout[i + 1]->takeover.load(), lasts[i]);
+
+        if (resume == chunk->first) {
+            chunk->last = lasts[i];
+            new_chunks.push_back(std::move(layout[i]));
+            continue;
+        }
+
+        int end = chunk->end;
+
+        chunk->next_frame = chunk->last.load();
+        if (resume < limit)
+            chunk->end = std::clamp(resume, chunk->start, end);
+
+        new_chunks.push_back(std::move(layout[i]));
+
+        if (resume >= limit)
+            continue;
+
+        new_chunks.push_back(std::make_unique<Chunk>());
+
+        // The new chunk can only line up with the old one at a scene change
+        // both find, so it starts a little before the last one found.
+        int first = resume;
+
+        if (scene_changes) {
+            int scene_change = chunk->first;
+            for (int n = chunk->first + 1; n < resume; n++)
+                if (chunk->getState(n) == FrameSceneChange)
+                    scene_change = n;
+
+            first = std::max(chunk->first, scene_change - SCENE_CHANGE_OVERLAP);
+        }
+
+        Chunk *rest = new_chunks.back().get();
+        rest->runner = this;
+        rest->checkpoint_index = i;
+        rest->resumed = true;
+        rest->first = first;
+        rest->start = std::clamp(resume, chunk->start, end);
+        rest->end = end;
+        rest->last = std::max(lasts[i], resume);
+        // Starting where the old chunk did, Scxvid has the same state in both from the start.
+        rest->takeover = scene_changes && first > chunk->first ? INT_MAX : first;
+        rest->next_frame = rest->first;
+
+        // If they don't line up, the old chunk does its frames again.
+        chunk->from_checkpoint = rest->takeover == INT_MAX;
+        rest->requests_in_flight = 0;
+
+        rest->states = std::make_unique<std::atomic<uint8_t>[]>(num_frames - rest->first);
+        for (int n = 0; n < num_frames - rest->first; n++)
+            rest->states[n] = FrameNotDone;
+    }
+
+    frames_done = frames_resumed;
+
+    int num_live_chunks = 0;
+
+    for (size_t i = 0; i < new_chunks.size(); i++) {
+        Chunk *chunk = new_chunks[i].get();
+        chunk->index = i;
+
+        if (chunk->next_frame == chunk->last && !chunk->from_checkpoint)
+            continue;
+
+        num_live_chunks++;
+
+        // The whole clip works for any chunk starting at 0.
+        if (chunk->first == 0) {
+            std::swap(chunk->vscore, chunks[0]->vscore);
+            std::swap(chunk->vsscript, chunks[0]->vsscript);
+            std::swap(chunk->vsnode, chunks[0]->vsnode);
+        } else {
+            // To the end of the clip, in case the chunk has to go on past last.
+            evaluateScript(chunk, job.generateChunkScript(chunk->first, num_frames));
+        }
+    }
+
+    for (auto &chunk : new_chunks)
+        if (chunk->vscore)
+            vsapi->setMaxCacheSize(max_cache_size / num_live_chunks, chunk->vscore);
+
+    chunks = std::move(new_chunks);
+}
+
+
+void WibblyJobRunner::createProject(const VSVideoInfo *vsvi) {
+    QString input_file = QString::fromStdString(job.getInputFile());
+    if (relative_paths)
+        input_file = QFileInfo(input_file).fileName();
+
+    project = new WobblyProject(false, input_file.toStdString(), job.getSourceFilter(), vsvi->fpsNum, vsvi->fpsDen, vsvi->width, vsvi->height, vsvi->numFrames);
+
+    // The project gets a combed frame or section at a time. Nothing displays its models, so don't announce every row.
+    project->beginBulkUpdate();
+
+    job.configureProject(project, vsvi->numFrames);
+}
+
+
+void WibblyJobRunner::start() {
+    chunks.push_back(std::make_unique<Chunk>());
+    chunks[0]->runner = this;
+    chunks[0]->index = 0;
+
+    std::string script = job.generateFinalScript();
+
+    // The checkpoint is only good for the same script.
+    script_hash = hashString(script);
+
+    // The whole clip tells how long the clip is, and how to split it.
+    evaluateScript(chunks[0].get(), script);
+
+    VSVideoInfo vsvi = *vsapi->getVideoInfo(chunks[0]->vsnode);
+
+    num_frames = vsvi.numFrames;
+
+    createProject(&vsvi);
+
+    int steps = job.getSteps();
+
+    if (!(steps & StepFieldMatch || steps & StepInterlacedFades || steps & StepDecimation || steps & StepSceneChanges)) {
+        // No metrics to collect. Just create the project file.
+        try {
+            project->endBulkUpdate();
+
+            project->writeProject(job.getOutputFile(), compact_project, binary_columns);
+
+            finish(QString());
+        } catch (WobblyException &e) {
+            finish(e.what());
+        }
+
+        return;
+    }
+
+    createChunks();
+
+    // The chunks from the checkpoint may not have lined up.
+    {
+        std::lock_guard<std::mutex> lock(reserve_mutex);
+        extendChunks();
+    }
+
+    elapsed_timer.start();
+    checkpoint_timer.start();
+
+    requestFrames();
+
+    // Everything may have been in the checkpoint already.
+    if (!requests_in_flight && !wantsFrames())
+        completeJob();
+}
+
+
+void WibblyJobRunner::cancel() {
+    aborted = true;
+}
+
+
+int WibblyJobRunner::getJobIndex() const {
+    return job_index;
+}
+
+
+int WibblyJobRunner::getFramesDone() const {
+    return frames_done;
+}
+
+
+int WibblyJobRunner::getFramesTotal() const {
+    return num_frames;
+}
+
+
+double WibblyJobRunner::getFramesPerSecond() const {
+    qint64 elapsed_milliseconds = elapsed_timer.isValid() ? elapsed_timer.elapsed() : 0;
+    if (!elapsed_milliseconds)
+        return 0;
+
+    return (double)(frames_done - frames_resumed) * 1000 / elapsed_milliseconds;
+}
+
+
+// Skips the merged chunks.
+WibblyJobRunner::Chunk *WibblyJobRunner::getPreviousChunk(const Chunk *chunk) const {
+    for (int i = chunk->index - 1; i >= 0; i--)
+        if (!chunks[i]->merged)
+            return chunks[i].get();
+
+    return nullptr;
+}
+
+
+// Skips the merged chunks.
+WibblyJobRunner::Chunk *WibblyJobRunner::getNextChunk(const Chunk *chunk) const {
+    for (size_t i = chunk->index + 1; i < chunks.size(); i++)
+        if (!chunks[i]->merged)
+            return chunks[i].get();
+
+    return nullptr;
+}
+
+
+// The chunk's frames must be requested up to here.
+int WibblyJobRunner::getLimit(const Chunk *chunk) const {
+    // The previous chunk does the rest of a merged chunk's frames.
+    if (chunk->merged)
+        return chunk->first;
+
+    const Chunk *next = getNextChunk(chunk);
+    if (!next)
+        return chunk->last;
+
+    return std::min(next->takeover.load(), chunk->last.load());
+}
+
+
+// Returns the first frame where both chunks found a scene change, or INT_MAX.
+int WibblyJobRunner::findTakeover(const Chunk *previous, const Chunk *chunk) const {
+    for (int n = chunk->first + 1; n < std::min(previous->last.load(), chunk->last.load()); n++)
+        if (previous->getState(n) == FrameSceneChange && chunk->getState(n) == FrameSceneChange)
+            return n;
+
+    return INT_MAX;
+}
+
+
+bool WibblyJobRunner::wantsFrames() const {
+    if (aborted || requests_in_flight >= max_requests)
+        return false;
+
+    for (auto &chunk : chunks)
+        if (chunk->next_frame < getLimit(chunk.get()))
+            return true;
+
+    return false;
+}
+
+
+// Requests frames until this job reaches its share, or the budget runs out.
+void WibblyJobRunner::requestFrames() {
+    while (wantsFrames()) {
+        // If there is nothing left in the budget, this runner gets a frame
+        // when some other job releases one.
+        if (!budget->acquire(this))
+            return;
+
+        int chunk_index;
+        int n = reserveFrame(chunk_index);
+        if (n < 0) {
+            budget->release();
+            return;
+        }
+
+        requestFrame(chunk_index, n);
+    }
+}
+
+
+void WibblyJobRunner::requestFrame(int chunk_index, int n) {
+    Chunk *chunk = chunks[chunk_index].get();
+
+    vsapi->getFrameAsync(n - chunk->first, chunk->vsnode, jobFrameDoneCallback, (void *)chunk);
+}
+
+
+// Returns the next frame to request, or -1 if this job doesn't want any more.
+// The frame comes from the chunk with the fewest requests in flight.
+int WibblyJobRunner::reserveFrame(int &chunk_index) {
+    std::lock_guard<std::mutex> lock(reserve_mutex);
+
+    if (aborted || requests_in_flight >= max_requests)
+        return -1;
+
+    Chunk *chunk = nullptr;
+
+    for (auto &c : chunks)
+        if (c->next_frame < getLimit(c.get()) && (!chunk || c->requests_in_flight < chunk->requests_in_flight))
+            chunk = c.get();
+
+    if (!chunk)
+        return -1;
+
+    ++requests_in_flight;
+    ++chunk->requests_in_flight;
+    ++outstanding;
+
+    chunk_index = chunk->index;
+
+    return chunk->next_frame++;
+}
+
+
+// The destructor waits for this to be called for every reserved frame.
+void WibblyJobRunner::endRequest() {
+    if (--outstanding == 0) {
+        std::lock_guard<std::mutex> lock(outstanding_mutex);
+        outstanding_condition.notify_all();
+    }
+}
+
+
+// Runs in the worker threads, possibly for several chunks at the same time.
+// Each frame's metrics go in its own slot, and get to the project only when all the frames are done.
+void WibblyJobRunner::frameDone(Chunk *chunk, const VSFrame *frame, int n, const char *error_msg) {
+    if (!frame) {
+        finish(QStringLiteral("Job number %1: failed to retrieve frame number %2. Error message:\n\n%3").arg(job_index + 1).arg(n).arg(error_msg));
+    } else if (aborted) {
+        vsapi->freeFrame(frame);
+    } else {
+        const VSMap *props = vsapi->getFramePropertiesRO(frame);
+
+        FrameMetrics metrics;
+
+        int err;
+
+        int64_t match = vsapi->mapGetInt(props, "VFMMatch", 0, &err);
+        if (!err)
+            metrics.match = match;
+
+        metrics.combed = vsapi->mapGetInt(props, "_Combed", 0, &err);
+
+        if (vsapi->mapNumElements(props, "VFMMics") == 5) {
+            const int64_t *mics = vsapi->mapGetIntArray(props, "VFMMics", &err);
+            for (int i = 0; i < 5; i++)
+                metrics.mics[i] = mics[i];
+            metrics.has_mics = true;
+        }
+
+        if (vsapi->mapNumElements(props, "MMetrics") == 2 && vsapi->mapNumElements(props, "VMetrics") == 2) {
+            const int64_t *mmetrics = vsapi->mapGetIntArray(props, "MMetrics", &err);
+            const int64_t *vmetrics = vsapi->mapGetIntArray(props, "VMetrics", &err);
+            for (int i = 0; i < 2; i++) {
+                metrics.mmetrics[i] = mmetrics[i];
+                metrics.vmetrics[i] = vmetrics[i];
+            }
+            metrics.has_dmetrics = true;
+        }
+
+        metrics.scene_change = vsapi->mapGetInt(props, "_SceneChangePrev", 0, &err);
+
+        int64_t decimate_metric = vsapi->mapGetInt(props, "VDecimateMaxBlockDiff", 0, &err);
+        if (!err) {
+            metrics.decimate_metric = decimate_metric;
+            metrics.has_decimate_metric = true;
+        }
+
+        metrics.decimated = vsapi->mapGetInt(props, "VDecimateDrop", 0, &err);
+
+        metrics.field_difference = vsapi->mapGetFloat(props, "WibblyFieldDifference", 0, &err);
+
+        vsapi->freeFrame(frame);
+
+        // Frames from the checkpoint done again are in it already.
+        bool redone = chunk->states[n - chunk->first] != FrameNotDone;
+
+        chunk->states[n - chunk->first] = metrics.scene_change ? FrameSceneChange : FrameDone;
+
+        if (metrics.scene_change)
+            lineUpChunks(chunk, n);
+
+        // A resumed chunk only has the right scene changes after it lines up with the frames it resumed after.
+        if (!redone && (!chunk->resumed || (n >= chunk->start && chunk->takeover != INT_MAX)))
+            addCheckpointRecord(chunk, n, metrics);
+
+        // The chunks overlap, so a frame may be done more than once.
+        if (!frame_metrics_done[n].exchange(true)) {
+            frame_metrics[n] = metrics;
+            ++frames_done;
+        }
+    }
+
+    --chunk->requests_in_flight;
+    --requests_in_flight;
+
+    {
+        std::lock_guard<std::mutex> lock(reserve_mutex);
+        extendChunks();
+    }
+
+    // Whoever waited longest gets this frame's place in the budget.
+    budget->release();
+
+    requestFrames();
+
+    // Whoever sees the last request come back puts the project together.
+    if (!requests_in_flight && !wantsFrames())
+        completeJob();
+
+    endRequest();
+}
+
+
+// A scene change found by two neighbouring chunks in the same frame means
+// Scxvid has the same state in both from there on.
+void WibblyJobRunner::lineUpChunks(Chunk *chunk, int n) {
+    // Not while extendChunks merges them.
+    std::lock_guard<std::mutex> lock(reserve_mutex);
+
+    if (chunk->merged)
+        return;
+
+    Chunk *previous = getPreviousChunk(chunk);
+
+    // Scxvid reports a scene change in the first frame of every chunk.
+    if (previous && n > chunk->first && previous->getState(n) == FrameSceneChange)
+        atomicMin(chunk->takeover, n);
+
+    Chunk *next = getNextChunk(chunk);
+
+    if (next && n > next->first && next->getState(n) == FrameSceneChange)
+        atomicMin(next->takeover, n);
+}
+
+
+// A chunk that got to its last frame without the next chunk lining up with
+// it goes on as far as the next chunk has frames. If they still don't line
+// up, it does the next chunk's frames too, and lines up with the one after.
+// Only the next chunk's scene changes are lost that way, not its metrics.
+//
+// The caller must hold reserve_mutex.
+void WibblyJobRunner::extendChunks() {
+    for (auto &c : chunks) {
+        Chunk *chunk = c.get();
+
+        while (!chunk->merged && chunk->next_frame >= chunk->last && !chunk->requests_in_flight) {
+            Chunk *next = getNextChunk(chunk);
+
+            if (next && next->takeover != INT_MAX)
+                break;
+
+            int reach = next ? getLimit(next) : num_frames;
+
+            if (chunk->last < reach) {
+                // Scxvid can't go on from frames found in the checkpoint, so
+                // they are done again, once the next chunk is done trying to
+                // line up with them.
+                if (chunk->from_checkpoint) {
+                    if (next && (next->next_frame < reach || next->requests_in_flight))
+                        break;
+
+                    chunk->from_checkpoint = false;
+                    chunk->next_frame = chunk->first;
+                }
+
+                chunk->last = reach;
+                break;
+            }
+
+            // The next chunk's frames still to come may yet line up.
+            if (!next || next->next_frame < reach || next->requests_in_flight)
+                break;
+
+            next->merged = true;
+
+            // It lined up with the merged chunk, which means nothing now.
+            Chunk *after = getNextChunk(chunk);
+            if (after)
+                after->takeover = findTakeover(chunk, after);
+        }
+    }
+}
+
+
+void WibblyJobRunner::completeJob() {
+    if (aborted || completed.exchange(true))
+        return;
+
+    const char match_chars[] = { 'p', 'c', 'n', 'b', 'u' };
+
+    try {
+        int from = 0;
+
+        // Every chunk has its frames from where it takes over to where the next chunk does.
+        // If a chunk takes over before the previous one did, Scxvid has the same state in all
+        // three, and the previous chunk has no frames to give.
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const Chunk *chunk = chunks[i].get();
+
+            if (chunk->merged)
+                continue;
+
+            const Chunk *next = getNextChunk(chunk);
+
+            from = std::max(from, chunk->takeover.load());
+            // extendChunks made sure every chunk but the first lined up.
+            int to = next ? next->takeover.load() : num_frames;
+
+            for (int n = from; n < to; n++) {
+                const FrameMetrics &metrics = frame_metrics[n];
+
+                if (metrics.match >= 0)
+                    project->setOriginalMatch(n, match_chars[metrics.match]);
+
+                if (metrics.combed)
+                    project->addCombedFrame(n);
+
+                if (metrics.has_mics)
+                    project->setMics(n, metrics.mics[0], metrics.mics[1], metrics.mics[2], metrics.mics[3], metrics.mics[4]);
+
+                if (metrics.has_dmetrics)
+                    project->setDMetrics(n, metrics.mmetrics[0], metrics.mmetrics[1], metrics.vmetrics[0], metrics.vmetrics[1]);
+
+                if (chunk->getState(n) == FrameSceneChange)
+                    project->addSection(n);
+
+                if (metrics.has_decimate_metric)
+                    project->setDecimateMetric(n, metrics.decimate_metric);
+
+                if (metrics.decimated)
+                    project->addDecimatedFrame(n);
+
+                if (metrics.field_difference > job.getFadesThreshold())
+                    project->addInterlacedFade(n, metrics.field_difference);
+            }
+        }
+
+        project->resetRangeMatches(0, num_frames - 1);
+
+        project->endBulkUpdate();
+
+        project->writeProject(job.getOutputFile(), compact_project, binary_columns);
+
+        {
+            std::lock_guard<std::mutex> lock(checkpoint_mutex);
+            checkpoint_records.clear();
+            checkpoint_file.close();
+            QFile::remove(getCheckpointPath());
+        }
+
+        frames_done = num_frames;
+
+        finish(QString());
+    } catch (WobblyException &e) {
+        finish(e.what());
+    }
+}
+
+
+void WibblyJobRunner::finish(const QString &error) {
+    if (done.exchange(true))
+        return;
+
+    if (!error.isEmpty())
+        aborted = true;
+
+    emit finished(job_index, error);
+}
+
+
+QString WibblyJobRunner::getCheckpointPath() const {
+    return QString::fromStdString(job.getOutputFile() + ".checkpoint");
+}
+
+
+// Returns the number of chunks the checkpoint was made with, or 0 if there is no checkpoint for this job.
+int WibblyJobRunner::readCheckpoint(std::vector<CheckpointRecord> &records) {
+    QFile file(getCheckpointPath());
+
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    CheckpointFileHeader header;
+
+    if (file.read((char *)&header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, checkpoint_file_magic, sizeof(header.magic)) ||
+        header.version != CHECKPOINT_FILE_VERSION ||
+        header.byte_order != checkpoint_file_byte_order ||
+        header.record_size != sizeof(CheckpointRecord) ||
+        header.num_frames != num_frames ||
+        header.num_chunks < 1 ||
+        header.script_hash != script_hash)
+        return 0;
+
+    // The last record may be cut short, if the job was killed while writing it.
+    qint64 num_records = (file.size() - (qint64)sizeof(header)) / (qint64)sizeof(CheckpointRecord);
+
+    records.resize(num_records);
+
+    if (file.read((char *)records.data(), num_records * sizeof(CheckpointRecord)) != num_records * (qint64)sizeof(CheckpointRecord)) {
+        records.clear();
+        return 0;
+    }
+
+    return header.num_chunks;
+}
+
+
+// Keeps the first num_records records, or starts a new checkpoint if there are none.
+void WibblyJobRunner::openCheckpoint(int num_chunks, size_t num_records) {
+    checkpoint_file.setFileName(getCheckpointPath());
+
+    bool ok;
+
+    if (num_records) {
+        qint64 size = sizeof(CheckpointFileHeader) + num_records * sizeof(CheckpointRecord);
+
+        ok = checkpoint_file.open(QIODevice::ReadWrite) &&
+             checkpoint_file.resize(size) &&
+             checkpoint_file.seek(size);
+    } else {
+        CheckpointFileHeader header = {};
+        memcpy(header.magic, checkpoint_file_magic, sizeof(header.magic));
+        header.version = CHECKPOINT_FILE_VERSION;
+        header.byte_order = checkpoint_file_byte_order;
+        header.record_size = sizeof(CheckpointRecord);
+        header.num_frames = num_frames;
+        header.num_chunks = num_chunks;
+        header.script_hash = script_hash;
+
+        ok = checkpoint_file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+             checkpoint_file.write((const char *)&header, sizeof(header)) == sizeof(header) &&
+             checkpoint_file.flush();
+    }
+
+    if (!ok) {
+        // Not worth failing the job over.
+        emit logMessage(mtWarning, QStringLiteral("Job number %1: couldn't open checkpoint file '%2'. If the job is interrupted, it will have to start over. Error message: %3").arg(job_index + 1).arg(checkpoint_file.fileName()).arg(checkpoint_file.errorString()));
+
+        checkpoint_file.close();
+    }
+}
+
+
+void WibblyJobRunner::addCheckpointRecord(const Chunk *chunk, int n, const FrameMetrics &metrics) {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+
+    if (!checkpoint_file.isOpen())
+        return;
+
+    checkpoint_records.push_back({ chunk->checkpoint_index, n, metrics });
+
+    // Writing every frame right away would make the workers wait for the disk.
+    if (checkpoint_records.size() >= CHECKPOINT_RECORDS || checkpoint_timer.elapsed() >= CHECKPOINT_INTERVAL)
+        writeCheckpointRecords();
+}
+
+
+// The caller must hold checkpoint_mutex.
+void WibblyJobRunner::writeCheckpointRecords() {
+    if (!checkpoint_file.isOpen() || checkpoint_records.empty())
+        return;
+
+    qint64 size = checkpoint_records.size() * sizeof(CheckpointRecord);
+
+    bool ok = checkpoint_file.write((const char *)checkpoint_records.data(), size) == size &&
+              checkpoint_file.flush();
+
+    checkpoint_records.clear();
+    checkpoint_timer.restart();
+
+    if (!ok) {
+        emit logMessage(mtWarning, QStringLiteral("Job number %1: couldn't write to checkpoint file '%2'. If the job is interrupted, it will have to start over. Error message: %3").arg(job_index + 1).arg(checkpoint_file.fileName()).arg(checkpoint_file.errorString()));
+
+        checkpoint_file.close();
+    }
+}
+
+
+WibblyJobQueue::WibblyJobQueue(const VSSCRIPTAPI *_vssapi, const std::vector<WibblyJob> &_jobs, int _concurrent_jobs, bool _compact_project, bool _binary_columns, bool _relative_paths, int64_t _max_cache_size, int _frame_requests, int _job_frame_requests, int _job_chunks)
+    : vssapi(_vssapi)
+    , jobs(_jobs)
+    , concurrent_jobs(_concurrent_jobs)
+    , compact_project(_compact_project)
+    , binary_columns(_binary_columns)
+    , relative_paths(_relative_paths)
+    , max_cache_size(_max_cache_size / _concurrent_jobs) // Each job gets its own cache, so they share the maximum.
+    , job_frame_requests(_job_frame_requests)
+    , job_chunks(_job_chunks)
+    , budget(_frame_requests)
+{
+
+}
+
+
+WibblyJobQueue::~WibblyJobQueue() {
+    for (WibblyJobRunner *runner : running_jobs)
+        runner->cancel();
+
+    // The destructors wait for the frames still in flight.
+    for (WibblyJobRunner *runner : running_jobs)
+        delete runner;
+}
+
+
+void WibblyJobQueue::start() {
+    startNextJobs();
+}
+
+
+void WibblyJobQueue::startNextJobs() {
+    while ((int)running_jobs.size() < concurrent_jobs && next_job < jobs.size()) {
+        int job_index = (int)next_job++;
+
+        WibblyJobRunner *runner = new WibblyJobRunner(vssapi, jobs[job_index], job_index, compact_project, binary_columns, relative_paths, max_cache_size, &budget, job_frame_requests, job_chunks);
+
+        // Queued, because start can emit finished before it returns.
+        connect(runner, &WibblyJobRunner::finished, this, &WibblyJobQueue::runnerFinished, Qt::QueuedConnection);
+        connect(runner, &WibblyJobRunner::logMessage, this, [this, job_index] (int msgType, const QString &msg) {
+            emit logMessage(job_index, msgType, msg);
+        });
+
+        running_jobs.push_back(runner);
+
+        try {
+            runner->start();
+        } catch (WobblyException &e) {
+            // One job failing doesn't stop the others.
+            running_jobs.pop_back();
+            delete runner;
+
+            jobs_finished++;
+            jobs_failed++;
+
+            emit jobFinished(job_index, nullptr, QString::fromUtf8(e.what()));
+
+            continue;
+        }
+
+        emit jobStarted(runner);
+    }
+
+    // The receivers may delete the queue, so nothing can come after this.
+    if (running_jobs.empty())
+        emit allFinished();
+}
+
+
+void WibblyJobQueue::runnerFinished(int job_index, const QString &error) {
+    auto it = std::find_if(running_jobs.begin(), running_jobs.end(), [job_index] (WibblyJobRunner *runner) {
+        return runner->getJobIndex() == job_index;
+    });
+
+    // Cancelled already.
+    if (it == running_jobs.end())
+        return;
+
+    WibblyJobRunner *runner = *it;
+    running_jobs.erase(it);
+
+    jobs_finished++;
+    if (!error.isEmpty())
+        jobs_failed++;
+
+    emit jobFinished(job_index, runner, error);
+
+    delete runner;
+
+    startNextJobs();
+}
+
+
+const std::vector<WibblyJobRunner *> &WibblyJobQueue::getRunningJobs() const {
+    return running_jobs;
+}
+
+
+int WibblyJobQueue::getJobsFinished() const {
+    return jobs_finished;
+}
+
+
+int WibblyJobQueue::getJobsFailed() const {
+    return jobs_failed;
+}
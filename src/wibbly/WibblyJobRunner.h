@@ -0,0 +1,315 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef WIBBLYJOBRUNNER_H
+#define WIBBLYJOBRUNNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+
+#include <VSScript4.h>
+
+#include "WibblyJob.h"
+
+
+class WibblyJobRunner;
+
+
+// Limits the number of frames requested by all the running jobs together.
+// When none are available, the runner is put in a queue and gets the next
+// one released.
+class FrameBudget {
+    std::mutex mutex;
+    int available;
+    std::deque<WibblyJobRunner *> waiting;
+
+public:
+    FrameBudget(int size);
+
+    // Returns false if the runner has to wait.
+    bool acquire(WibblyJobRunner *runner);
+    void release();
+
+    void forget(WibblyJobRunner *runner);
+};
+
+
+// Everything Wibbly collects about one frame.
+struct FrameMetrics {
+    int8_t match = -1; // Index in "pcnbu".
+    bool combed = false;
+    bool has_mics = false;
+    bool has_dmetrics = false;
+    bool scene_change = false;
+    bool has_decimate_metric = false;
+    bool decimated = false;
+    int16_t mics[5] = { };
+    int32_t mmetrics[2] = { };
+    int32_t vmetrics[2] = { };
+    int32_t decimate_metric = 0;
+    double field_difference = 0;
+};
+
+
+// What the checkpoint file holds for every frame. The chunk is the one in
+// the layout the job started with.
+struct CheckpointRecord {
+    int32_t chunk;
+    int32_t frame;
+    FrameMetrics metrics;
+};
+
+
+// Collects the metrics for one job, with its own VSScript environments and
+// project, so several jobs can run at the same time.
+//
+// A long job can be split into chunks, each evaluated in its own VapourSynth
+// core, so that the decoder and Scxvid, which only work on one frame at a
+// time, run in parallel. Everything but Scxvid gives the same results no
+// matter which frames are requested, because the chunks only cut the clip
+// right before Scxvid. Scxvid starts over at the beginning of each chunk, so
+// every chunk but the first starts a little early, and takes over from the
+// previous chunk at the first frame where both found a scene change. From
+// there on Scxvid has the same state in both chunks. If the previous chunk
+// gets to its last frame before that happens, it goes on as far as the next
+// chunk has frames, and failing that, does the next chunk's frames itself.
+//
+// The metrics are also appended to a checkpoint file next to the project,
+// which is removed when the project is written. If the job is started again
+// after failing or being cancelled, only the frames missing from the
+// checkpoint are requested. Each chunk resumes after the frames it had done
+// in a row, as a new chunk lined up with the old one like any other. If that
+// never happens, the old chunk's frames are done again from its start.
+class WibblyJobRunner : public QObject {
+    Q_OBJECT
+
+    enum FrameState {
+        FrameNotDone = 0,
+        FrameDone,
+        FrameSceneChange
+    };
+
+    struct Chunk {
+        WibblyJobRunner *runner;
+        int index;
+        int checkpoint_index; // Chunk in the checkpoint's layout.
+        bool resumed = false; // Started again after the frames found in the checkpoint.
+        bool from_checkpoint = false; // Scxvid has to start over at first to go on from its frames.
+
+        VSCore *vscore = nullptr;
+        VSScript *vsscript = nullptr;
+        VSNode *vsnode = nullptr;
+
+        int first; // First frame requested. Frames before start only line up Scxvid.
+        int start; // Where the chunk would start without Scxvid.
+        int end; // Where the next chunk would start without Scxvid.
+
+        // Past here the next chunk can't be lined up with this one. Moved
+        // further when it isn't lined up by then.
+        std::atomic<int> last;
+
+        // Where this chunk takes over from the previous one, if known.
+        std::atomic<int> takeover;
+
+        // Never lined up, so the previous chunk does its frames instead.
+        std::atomic<bool> merged = false;
+
+        std::atomic<int> next_frame;
+        std::atomic<int> requests_in_flight;
+
+        std::unique_ptr<std::atomic<uint8_t>[]> states; // From first to the end of the clip.
+
+        ~Chunk();
+
+        uint8_t getState(int n) const;
+    };
+
+    const VSSCRIPTAPI *vssapi;
+    const VSAPI *vsapi;
+
+    WibblyJob job;
+    int job_index;
+
+    bool compact_project;
+    bool binary_columns;
+    bool relative_paths;
+    int64_t max_cache_size;
+    int max_chunks;
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    int num_frames = 0;
+
+    // Only Scxvid gives different results in different chunks, so every
+    // frame's metrics are kept once, by whichever chunk gets it first. The
+    // scene changes come from the chunks' states.
+    std::vector<FrameMetrics> frame_metrics;
+    std::unique_ptr<std::atomic<bool>[]> frame_metrics_done;
+
+    WobblyProject *project = nullptr;
+
+    FrameBudget *budget;
+    int max_requests;
+
+    std::mutex reserve_mutex;
+
+    std::atomic<int> frames_done;
+    std::atomic<int> requests_in_flight;
+    std::atomic<int> outstanding; // Reserved frames whose callbacks haven't returned yet.
+    std::atomic<bool> aborted;
+    std::atomic<bool> completed;
+    std::atomic<bool> done;
+
+    std::mutex outstanding_mutex;
+    std::condition_variable outstanding_condition;
+
+    QElapsedTimer elapsed_timer;
+    int frames_resumed = 0;
+
+    uint64_t script_hash = 0;
+    QFile checkpoint_file;
+    std::mutex checkpoint_mutex;
+    std::vector<CheckpointRecord> checkpoint_records; // Not written yet.
+    QElapsedTimer checkpoint_timer;
+
+
+    void evaluateScript(Chunk *chunk, const std::string &script);
+    void createChunks();
+    void createProject(const VSVideoInfo *vsvi);
+
+    Chunk *getPreviousChunk(const Chunk *chunk) const;
+    Chunk *getNextChunk(const Chunk *chunk) const;
+    int getLimit(const Chunk *chunk) const;
+    int findTakeover(const Chunk *previous, const Chunk *chunk) const;
+    bool wantsFrames() const;
+
+    void requestFrames();
+    void requestFrame(int chunk_index, int n);
+    int reserveFrame(int &chunk_index);
+    void endRequest();
+
+    void frameDone(Chunk *chunk, const VSFrame *frame, int n, const char *error_msg);
+    void lineUpChunks(Chunk *chunk, int n);
+    void extendChunks();
+    void completeJob();
+    void finish(const QString &error);
+
+    QString getCheckpointPath() const;
+    int readCheckpoint(std::vector<CheckpointRecord> &records);
+    void openCheckpoint(int num_chunks, size_t num_records);
+    void addCheckpointRecord(const Chunk *chunk, int n, const FrameMetrics &metrics);
+    void writeCheckpointRecords();
+
+    friend class FrameBudget;
+    friend void VS_CC jobFrameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg);
+    friend void VS_CC jobMessageHandler(int msgType, const char *msg, void *userData);
+
+public:
+    // max_cache_size is in bytes. max_requests is this job's share of the budget, at most.
+    WibblyJobRunner(const VSSCRIPTAPI *_vssapi, const WibblyJob &_job, int _job_index, bool _compact_project, bool _binary_columns, bool _relative_paths, int64_t _max_cache_size, FrameBudget *_budget, int _max_requests, int _max_chunks = 1);
+
+    // Waits for the frames still in flight.
+    ~WibblyJobRunner();
+
+    // Evaluates the scripts and starts requesting frames. Throws WobblyException.
+    // Emits finished when the project was written, possibly before returning.
+    void start();
+
+    void cancel();
+
+    int getJobIndex() const;
+
+    int getFramesDone() const;
+    int getFramesTotal() const;
+
+    double getFramesPerSecond() const;
+
+signals:
+    // The error is empty if the job succeeded. Emitted from the worker threads.
+    void finished(int job_index, const QString &error);
+
+    void logMessage(int msgType, const QString &msg);
+};
+
+
+// Runs a list of jobs, a few at a time, all sharing one FrameBudget. Both
+// Wibbly and wibbly-cli drive their jobs with this.
+class WibblyJobQueue : public QObject {
+    Q_OBJECT
+
+    const VSSCRIPTAPI *vssapi;
+
+    std::vector<WibblyJob> jobs;
+
+    int concurrent_jobs;
+    bool compact_project;
+    bool binary_columns;
+    bool relative_paths;
+    int64_t max_cache_size; // For each job.
+    int job_frame_requests;
+    int job_chunks;
+
+    FrameBudget budget;
+
+    std::vector<WibblyJobRunner *> running_jobs;
+    size_t next_job = 0;
+    int jobs_finished = 0;
+    int jobs_failed = 0;
+
+
+    void startNextJobs();
+    void runnerFinished(int job_index, const QString &error);
+
+public:
+    // max_cache_size is in bytes, shared by the jobs running at the same time.
+    WibblyJobQueue(const VSSCRIPTAPI *_vssapi, const std::vector<WibblyJob> &_jobs, int _concurrent_jobs, bool _compact_project, bool _binary_columns, bool _relative_paths, int64_t _max_cache_size, int _frame_requests, int _job_frame_requests, int _job_chunks);
+
+    // Cancels the jobs still running and waits for their frames in flight.
+    ~WibblyJobQueue();
+
+    // Starts the first jobs. Emits allFinished when every job finished or
+    // failed, possibly before returning.
+    void start();
+
+    const std::vector<WibblyJobRunner *> &getRunningJobs() const;
+
+    int getJobsFinished() const;
+    int getJobsFailed() const;
+
+signals:
+    void jobStarted(const WibblyJobRunner *runner);
+
+    // runner is nullptr if the job couldn't start. Otherwise it is deleted
+    // right after the signal.
+    void jobFinished(int job_index, const WibblyJobRunner *runner, const QString &error);
+
+    void logMessage(int job_index, int msgType, const QString &msg);
+
+    void allFinished();
+};
+
+#endif // WIBBLYJOBRUNNER_H
@@ -19,8 +19,7 @@ SOFTWARE.
 */
 
 
-#include <condition_variable>
-#include <mutex>
+#include <algorithm>
 
 #include <QApplication>
 #include <QButtonGroup>
@@ -43,6 +42,7 @@ SOFTWARE.
 #include "ScrollArea.h"
 #include "WibblyWindow.h"
 #include "WobblyException.h"
+#include "WobblyFilters.h"
 #include "WobblyShared.h"
 
 
@@ -54,8 +54,14 @@ SOFTWARE.
 #define KEY_LAST_DIR                        QStringLiteral("user_interface/last_dir")
 #define KEY_LAST_CROP                       QStringLiteral("user_interface/last_crop")
 
+#define KEY_CONCURRENT_JOBS                 QStringLiteral("metrics/concurrent_jobs")
+#define KEY_FRAME_REQUESTS                  QStringLiteral("metrics/frame_requests")
+#define KEY_JOB_FRAME_REQUESTS              QStringLiteral("metrics/job_frame_requests")
+#define KEY_JOB_CHUNKS                      QStringLiteral("metrics/job_chunks")
+
 #define KEY_COMPACT_PROJECT_FILES           QStringLiteral("projects/compact_project_files")
 #define KEY_USE_RELATIVE_PATHS              QStringLiteral("projects/use_relative_paths")
+#define KEY_BINARY_COLUMNS                  QStringLiteral("projects/binary_columns")
 
 #define KEY_JOBS                            QStringLiteral("jobs")
 #define KEY_COUNT                           QStringLiteral("jobs/count")
@@ -74,13 +80,8 @@ SOFTWARE.
 #define KEY_DMETRICS_NT                     QStringLiteral("dmetrics/nt")
 
 
-static std::mutex requests_mutex;
-static std::condition_variable requests_condition;
-
-
 WibblyWindow::WibblyWindow()
     : QMainWindow()
-    , request_count(0)
 #ifdef _WIN32
     , settings(QApplication::applicationDirPath() + "/wibbly.ini", QSettings::IniFormat)
 #endif
@@ -171,6 +172,12 @@ void WibblyWindow::initialiseVapourSynth() {
     vsscript = vssapi->createScript(vscore);
     if (!vsscript)
         throw WobblyException(std::string("Fatal error: failed to create VSScript object. Error message: ") + vssapi->getError(vsscript));
+
+    // Used by the scripts with the interlaced fades step.
+    VSMap *m = vsapi->createMap();
+    vsapi->mapConsumeFunction(m, "wibbly_field_difference", createFieldDifferenceFunction(vsapi, vscore), maReplace);
+    vssapi->setVariables(vsscript, m);
+    vsapi->freeMap(m);
 }
 
 
@@ -192,6 +199,8 @@ void WibblyWindow::closeEvent(QCloseEvent *event) {
 
     writeSettings();
 
+    stopJobs();
+
     cleanUpVapourSynth();
 
     event->accept();
@@ -364,6 +373,9 @@ void WibblyWindow::createMainWindow() {
     main_progress_dialog->setLabel(new QLabel);
     main_progress_dialog->reset();
 
+    progress_timer = new QTimer(this);
+    progress_timer->setInterval(1000);
+
     QPushButton *main_engage_button = new QPushButton("Engage");
 
 
@@ -611,16 +623,11 @@ void WibblyWindow::createMainWindow() {
             return;
         }
 
-        startNextJob();
+        startJobs();
     });
 
     connect(main_progress_dialog, &ProgressDialog::canceled, [this] () {
-        aborted = true;
-
-        delete current_project;
-        current_project = nullptr;
-
-        current_job = -1;
+        stopJobs();
 
         int current_row = main_jobs_list->currentRow();
         main_jobs_list->setCurrentRow(-1, QItemSelectionModel::NoUpdate);
@@ -629,6 +636,8 @@ void WibblyWindow::createMainWindow() {
         setEnabled(true);
     });
 
+    connect(progress_timer, &QTimer::timeout, this, &WibblyWindow::updateProgress);
+
     connect(main_progress_dialog, &ProgressDialog::minimiseChanged, [this] (bool minimised) {
         if (minimised)
             setWindowState(windowState() | Qt::WindowMinimized);
@@ -1081,12 +1090,34 @@ void WibblyWindow::createSettingsWindow() {
 
     settings_use_relative_paths_check = new QCheckBox(QStringLiteral("Use relative paths in project files"));
 
+    settings_binary_columns_check = new QCheckBox(QStringLiteral("Store per-frame data in a binary file next to the project"));
+
     settings_cache_spin = new QSpinBox;
     settings_cache_spin->setRange(1, 99999);
     settings_cache_spin->setValue(4096);
     settings_cache_spin->setPrefix(QStringLiteral("Maximum cache size: "));
     settings_cache_spin->setSuffix(QStringLiteral(" MiB"));
 
+    settings_concurrent_jobs_spin = new QSpinBox;
+    settings_concurrent_jobs_spin->setRange(1, 64);
+    settings_concurrent_jobs_spin->setValue(2);
+    settings_concurrent_jobs_spin->setPrefix(QStringLiteral("Jobs running at the same time: "));
+
+    settings_frame_requests_spin = new QSpinBox;
+    settings_frame_requests_spin->setRange(1, 1024);
+    settings_frame_requests_spin->setValue(QThread::idealThreadCount());
+    settings_frame_requests_spin->setPrefix(QStringLiteral("Frames requested at once, all jobs: "));
+
+    settings_job_frame_requests_spin = new QSpinBox;
+    settings_job_frame_requests_spin->setRange(1, 1024);
+    settings_job_frame_requests_spin->setValue(QThread::idealThreadCount());
+    settings_job_frame_requests_spin->setPrefix(QStringLiteral("Frames requested at once, one job: "));
+
+    settings_job_chunks_spin = new QSpinBox;
+    settings_job_chunks_spin->setRange(1, 64);
+    settings_job_chunks_spin->setValue(1);
+    settings_job_chunks_spin->setPrefix(QStringLiteral("Chunks per job: "));
+
 
     connect(settings_font_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
         QFont font = QApplication::font();
@@ -1104,10 +1135,30 @@ void WibblyWindow::createSettingsWindow() {
         settings.setValue(KEY_USE_RELATIVE_PATHS, checked);
     });
 
+    connect(settings_binary_columns_check, &QCheckBox::clicked, [this] (bool checked) {
+        settings.setValue(KEY_BINARY_COLUMNS, checked);
+    });
+
     connect(settings_cache_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
         settings.setValue(KEY_MAXIMUM_CACHE_SIZE, value);
     });
 
+    connect(settings_concurrent_jobs_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_CONCURRENT_JOBS, value);
+    });
+
+    connect(settings_frame_requests_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_FRAME_REQUESTS, value);
+    });
+
+    connect(settings_job_frame_requests_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_JOB_FRAME_REQUESTS, value);
+    });
+
+    connect(settings_job_chunks_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_JOB_CHUNKS, value);
+    });
+
 
     QVBoxLayout *vbox = new QVBoxLayout;
 
@@ -1121,11 +1172,36 @@ void WibblyWindow::createSettingsWindow() {
     hbox->addStretch(1);
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout;
+    hbox->addWidget(settings_binary_columns_check);
+    hbox->addStretch(1);
+    vbox->addLayout(hbox);
+
     hbox = new QHBoxLayout;
     hbox->addWidget(settings_cache_spin);
     hbox->addStretch(1);
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout;
+    hbox->addWidget(settings_concurrent_jobs_spin);
+    hbox->addStretch(1);
+    vbox->addLayout(hbox);
+
+    hbox = new QHBoxLayout;
+    hbox->addWidget(settings_frame_requests_spin);
+    hbox->addStretch(1);
+    vbox->addLayout(hbox);
+
+    hbox = new QHBoxLayout;
+    hbox->addWidget(settings_job_frame_requests_spin);
+    hbox->addStretch(1);
+    vbox->addLayout(hbox);
+
+    hbox = new QHBoxLayout;
+    hbox->addWidget(settings_job_chunks_spin);
+    hbox->addStretch(1);
+    vbox->addLayout(hbox);
+
     vbox->addStretch(1);
 
 
@@ -1146,17 +1222,6 @@ void WibblyWindow::createSettingsWindow() {
 
 
 void WibblyWindow::realOpenVideo(const QString &path) {
-    QString source_filter;
-
-    QString extension = path.mid(path.lastIndexOf('.') + 1);
-
-    if (extension == "dgi")
-        source_filter = "dgdecodenv.DGSource";
-    else if (extension == "d2v")
-        source_filter = "d2v.Source";
-    else
-        source_filter = "bs.VideoSource";
-
     jobs.emplace_back();
 
     WibblyJob &job = jobs.back();
@@ -1164,7 +1229,7 @@ void WibblyWindow::realOpenVideo(const QString &path) {
     job.setCrop(settings_last_crop[0], settings_last_crop[1], settings_last_crop[2], settings_last_crop[3]);
 
     job.setInputFile(path.toStdString());
-    job.setSourceFilter(source_filter.toStdString());
+    job.setSourceFilter(WibblyJob::guessSourceFilter(path.toStdString()));
     job.setOutputFile(QStringLiteral("%1.wob").arg(path).toStdString());
 
     main_jobs_list->addItem(path);
@@ -1250,11 +1315,6 @@ void WibblyWindow::evaluateDisplayScript() {
         throw WobblyException("Failed to evaluate display script. Error message:\n" + error);
     }
 
-    // Wait until all requests are done before freeing the node.
-    std::unique_lock<std::mutex> lock(requests_mutex);
-    while (request_count)
-        requests_condition.wait(lock);
-
     vsapi->freeNode(vsnode);
 
     vsnode = vssapi->getOutputNode(vsscript, 0);
@@ -1303,12 +1363,15 @@ void WibblyWindow::displayFrame(int n) {
     if (!frame)
         throw WobblyException(std::string("Failed to retrieve frame. Error message: ") + error.data());
 
-    int width = vsapi->getFrameWidth(frame, 0);
-    int height = vsapi->getFrameHeight(frame, 0);
-    uint8_t *frame_data = packRGBFrame(vsapi, frame);
+    QSize size(vsapi->getFrameWidth(frame, 0), vsapi->getFrameHeight(frame, 0));
+    if (frame_image.size() != size)
+        frame_image = QImage(size, QImage::Format_RGB32);
+
+    packRGBFrame(vsapi, frame, frame_image.bits(), frame_image.bytesPerLine());
     vsapi->freeFrame(frame);
 
-    QPixmap pixmap = QPixmap::fromImage(QImage(frame_data, width, height, width * 4, QImage::Format_RGB32, free, frame_data));
+    // Copies the pixels, so frame_image can be reused for the next frame.
+    QPixmap pixmap = QPixmap::fromImage(frame_image);
 
     video_frame_label->setPixmap(pixmap);
 
@@ -1339,258 +1402,121 @@ void WibblyWindow::displayFrame(int n) {
 }
 
 
-void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg) {
-    WibblyWindow *window = (WibblyWindow *)userData;
-
-    // Qt::DirectConnection = frameDone runs in the worker threads
-    // Qt::QueuedConnection = frameDone runs in the GUI thread
-    QMetaObject::invokeMethod(window, "frameDone", Qt::DirectConnection, Q_ARG(void *, (void *)f), Q_ARG(int, n), Q_ARG(QString, QString(errorMsg)));
-}
-
-
 // Always runs in the GUI thread.
-void WibblyWindow::startNextJob() {
-    current_job++;
-
-    if (current_job == (int)jobs.size()) {
-        // No more jobs.
-        current_job = -1;
-
-        int current_row = main_jobs_list->currentRow();
-        main_jobs_list->setCurrentRow(-1, QItemSelectionModel::NoUpdate);
-        main_jobs_list->setCurrentRow(current_row, QItemSelectionModel::NoUpdate);
-
-        QApplication::alert(this, 0);
-
-        // Re-enable the user interface.
-        setEnabled(true);
-
-        return;
-    }
-
-    setEnabled(false);
-
-    const WibblyJob &job = jobs[current_job];
-
-    try {
-        evaluateFinalScript(current_job);
-    } catch (WobblyException &e) {
-        errorPopup(e.what());
-        return;
-    }
-
-    QString input_file = QString::fromStdString(job.getInputFile());
-    if (settings_use_relative_paths_check->isChecked())
-        input_file = QFileInfo(input_file).fileName();
-
-    current_project = new WobblyProject(false, input_file.toStdString(), job.getSourceFilter(), vsvi->fpsNum, vsvi->fpsDen, vsvi->width, vsvi->height, vsvi->numFrames);
-
-    auto trims = job.getTrims();
-    for (auto it = trims.cbegin(); it != trims.cend(); it++)
-        current_project->addTrim(it->second.first, it->second.last);
-
-    if (!trims.size())
-        current_project->addTrim(0, vsvi->numFrames - 1);
-
-    int steps = job.getSteps();
-
-    if (steps & StepFieldMatch) {
-        for (size_t i = 0; i < vfm_params.size(); i++) {
-            if (vfm_params[i].type == VIVTCParamInt) {
-                current_project->setVFMParameter(vfm_params[i].name.toStdString(), job.getVFMParameterInt(vfm_params[i].name.toStdString()));
-            } else if (vfm_params[i].type == VIVTCParamDouble) {
-                current_project->setVFMParameter(vfm_params[i].name.toStdString(), job.getVFMParameterDouble(vfm_params[i].name.toStdString()));
-            } else if (vfm_params[i].type == VIVTCParamBool) {
-                current_project->setVFMParameter(vfm_params[i].name.toStdString(), job.getVFMParameterBool(vfm_params[i].name.toStdString()));
-            }
-        }
-    }
-
-    if (steps & StepDecimation) {
-        for (size_t i = 0; i < vdecimate_params.size(); i++) {
-            if (vdecimate_params[i].type == VIVTCParamInt) {
-                current_project->setVDecimateParameter(vdecimate_params[i].name.toStdString(), job.getVDecimateParameterInt(vdecimate_params[i].name.toStdString()));
-            } else if (vdecimate_params[i].type == VIVTCParamDouble) {
-                current_project->setVDecimateParameter(vdecimate_params[i].name.toStdString(), job.getVDecimateParameterDouble(vdecimate_params[i].name.toStdString()));
-            } else if (vdecimate_params[i].type == VIVTCParamBool) {
-                current_project->setVDecimateParameter(vdecimate_params[i].name.toStdString(), job.getVDecimateParameterBool(vdecimate_params[i].name.toStdString()));
-            }
-        }
-    }
-
-    if (!(steps & StepFieldMatch || steps & StepInterlacedFades || steps & StepDecimation || steps & StepSceneChanges)) {
-        // No metrics to collect. Just create the project file and move on.
-        try {
-            current_project->writeProject(job.getOutputFile(), settings_compact_projects_check->isChecked());
-
-            delete current_project;
-            current_project = nullptr;
-        } catch (WobblyException &e) {
-            errorPopup(e.what());
+void WibblyWindow::startJobs() {
+    job_queue = new WibblyJobQueue(vssapi,
+                                   jobs,
+                                   settings_concurrent_jobs_spin->value(),
+                                   settings_compact_projects_check->isChecked(),
+                                   settings_binary_columns_check->isChecked(),
+                                   settings_use_relative_paths_check->isChecked(),
+                                   (int64_t)settings_cache_spin->value() * 1024 * 1024,
+                                   settings_frame_requests_spin->value(),
+                                   settings_job_frame_requests_spin->value(),
+                                   settings_job_chunks_spin->value());
+
+    connect(job_queue, &WibblyJobQueue::logMessage, this, [this] (int, int msgType, const QString &msg) {
+        vsLogPopup(msgType, msg);
+    });
 
-            delete current_project;
-            current_project = nullptr;
-        }
+    connect(job_queue, &WibblyJobQueue::jobFinished, this, [this] (int, const WibblyJobRunner *, const QString &error) {
+        if (!error.isEmpty())
+            job_errors += error + "\n\n";
 
-        QApplication::processEvents();
+        updateProgress();
+    });
 
-        // A little recursion, but surely there won't be enough jobs to make it a problem.
-        startNextJob();
+    connect(job_queue, &WibblyJobQueue::allFinished, this, &WibblyWindow::finishJobs);
 
-        return;
-    }
+    job_errors.clear();
 
-    progress_dialog_label_text = QStringLiteral("Job %1/%2:\n%3").arg(current_job + 1).arg(jobs.size()).arg(QString::fromStdString(job.getOutputFile()));
-
-    main_progress_dialog->setLabelText(progress_dialog_label_text + "\n\n");
+    main_progress_dialog->setLabelText(QString());
     main_progress_dialog->setMinimum(0);
-    main_progress_dialog->setMaximum(vsvi->numFrames);
+    main_progress_dialog->setMaximum((int)jobs.size() * 1000);
     main_progress_dialog->setValue(0);
 
-    VSCoreInfo core_info;
-    vsapi->getCoreInfo(vscore, &core_info);
-    int requests = std::min(core_info.numThreads, vsvi->numFrames);
-
-    aborted = false;
+    progress_timer->start();
 
-    frames_left = vsvi->numFrames;
-
-    next_frame = 0;
-    elapsed_timer.start();
-    update_timer.start();
-    for (int i = 0; i < requests; i++) {
-        ++request_count;
-        vsapi->getFrameAsync(next_frame, vsnode, frameDoneCallback, (void *)this);
-        next_frame++;
-    }
+    job_queue->start();
 }
 
 
-// Runs in the worker threads, so don't touch the GUI directly.
-// The worker threads are queued up inside VapourSynth, so they run one at a time.
-void WibblyWindow::frameDone(void *frame_v, int n, const QString &error_msg) {
-    const VSFrame *frame = (const VSFrame *)frame_v;
-
-    if (aborted) {
-        vsapi->freeFrame(frame);
-    } else {
-        if (frame) {
-            const VSMap *props = vsapi->getFramePropertiesRO(frame);
+void WibblyWindow::stopJobs() {
+    progress_timer->stop();
 
-            int err;
-
-            const char match_chars[] = { 'p', 'c', 'n', 'b', 'u' };
-            int64_t match = vsapi->mapGetInt(props, "VFMMatch", 0, &err);
-            if (!err)
-                current_project->setOriginalMatch(n, match_chars[match]);
-
-            if (vsapi->mapGetInt(props, "_Combed", 0, &err))
-                current_project->addCombedFrame(n);
+    // The destructor cancels the jobs still running and waits for their frames in flight.
+    delete job_queue;
+    job_queue = nullptr;
+}
 
-            if (vsapi->mapNumElements(props, "VFMMics") == 5) {
-                const int64_t *mics = vsapi->mapGetIntArray(props, "VFMMics", &err);
-                current_project->setMics(n, mics[0], mics[1], mics[2], mics[3], mics[4]);
-            }
 
-            if (vsapi->mapNumElements(props, "MMetrics") == 2 && vsapi->mapNumElements(props, "VMetrics") == 2) {
-                const int64_t *mmetrics = vsapi->mapGetIntArray(props, "MMetrics", &err);
-                const int64_t *vmetrics = vsapi->mapGetIntArray(props, "VMetrics", &err);
-                current_project->setDMetrics(n, mmetrics[0], mmetrics[1], vmetrics[0], vmetrics[1]);
-            }
+void WibblyWindow::finishJobs() {
+    progress_timer->stop();
 
-            if (vsapi->mapGetInt(props, "_SceneChangePrev", 0, &err))
-                current_project->addSection(n);
+    // Called from inside the queue, which has no jobs left by now.
+    job_queue->deleteLater();
+    job_queue = nullptr;
 
-            int64_t decimate_metric = vsapi->mapGetInt(props, "VDecimateMaxBlockDiff", 0, &err);
-            if (!err)
-                current_project->setDecimateMetric(n, decimate_metric);
+    main_progress_dialog->reset();
 
-            if (vsapi->mapGetInt(props, "VDecimateDrop", 0, &err))
-                current_project->addDecimatedFrame(n);
+    int current_row = main_jobs_list->currentRow();
+    main_jobs_list->setCurrentRow(-1, QItemSelectionModel::NoUpdate);
+    main_jobs_list->setCurrentRow(current_row, QItemSelectionModel::NoUpdate);
 
-            double field_difference = vsapi->mapGetFloat(props, "WibblyFieldDifference", 0, &err);
-            if (field_difference > jobs[current_job].getFadesThreshold())
-                current_project->addInterlacedFade(n, field_difference);
+    QApplication::alert(this, 0);
 
-            vsapi->freeFrame(frame);
+    // Re-enable the user interface.
+    setEnabled(true);
 
-            if (next_frame < vsvi->numFrames) {
-                ++request_count;
-                vsapi->getFrameAsync(next_frame, vsnode, frameDoneCallback, (void *)this);
-                next_frame++;
-            }
+    if (!job_errors.isEmpty()) {
+        QMessageBox msg;
+        msg.setText(QStringLiteral("Some jobs failed."));
+        msg.setDetailedText(job_errors);
+        msg.exec();
+    }
+}
 
-            frames_left--;
-
-            // Speed and time remaining updated every five seconds,
-            // or as long as it takes to process a frames, whichever is larger.
-            if (update_timer.elapsed() >= 5000) {
-                update_timer.start();
-
-                qint64 elapsed_milliseconds = elapsed_timer.elapsed();
-                double frames_per_second = (double)(vsvi->numFrames - frames_left) * 1000 / elapsed_milliseconds;
-                int seconds_left = (int)(frames_left / frames_per_second);
-                int minutes_left = seconds_left / 60;
-                seconds_left = seconds_left % 60;
-                int hours_left = minutes_left / 60;
-                minutes_left = minutes_left % 60;
-
-                QMetaObject::invokeMethod(
-                            main_progress_dialog,
-                            "setLabelText",
-                            Qt::QueuedConnection,
-                            Q_ARG(QString, QStringLiteral("%1\n\n%2 fps, %3:%4:%5 to finish this job")
-                                  .arg(progress_dialog_label_text)
-                                  .arg(frames_per_second, 0, 'f', 2)
-                                  .arg(hours_left, 2, 10, QLatin1Char('0'))
-                                  .arg(minutes_left, 2, 10, QLatin1Char('0'))
-                                  .arg(seconds_left, 2, 10, QLatin1Char('0'))));
-            }
 
-            QMetaObject::invokeMethod(
-                        main_progress_dialog,
-                        "setValue",
-                        Qt::QueuedConnection,
-                        Q_ARG(int, vsvi->numFrames - frames_left));
+void WibblyWindow::updateProgress() {
+    if (!job_queue)
+        return;
 
-            if (frames_left == 0) {
-                try {
-                    current_project->resetRangeMatches(0, vsvi->numFrames - 1);
+    const std::vector<WibblyJobRunner *> &running_jobs = job_queue->getRunningJobs();
+    int jobs_finished = job_queue->getJobsFinished();
 
-                    // If the project was successfully saved earlier, this will probably work.
-                    current_project->writeProject(jobs[current_job].getOutputFile(), settings_compact_projects_check->isChecked());
+    int value = jobs_finished * 1000;
 
-                    delete current_project;
-                    current_project = nullptr;
+    QString text = QStringLiteral("Jobs finished: %1/%2").arg(jobs_finished).arg(jobs.size());
 
-                    QMetaObject::invokeMethod(this, "startNextJob", Qt::QueuedConnection);
-                } catch (WobblyException &e) {
-                    QMetaObject::invokeMethod(this, "errorPopup", Qt::QueuedConnection, Q_ARG(QString, QString(e.what())));
+    for (size_t i = 0; i < running_jobs.size(); i++) {
+        const WibblyJobRunner *runner = running_jobs[i];
 
-                    aborted = true;
-                    current_job = -1;
-                    QMetaObject::invokeMethod(this, "setEnabled", Qt::QueuedConnection, Q_ARG(bool, true));
+        int frames_total = runner->getFramesTotal();
+        int frames_done = runner->getFramesDone();
+        if (!frames_total)
+            continue;
 
-                    delete current_project;
-                    current_project = nullptr;
-                }
-            }
-        } else {
-            aborted = true;
+        value += (int)((int64_t)frames_done * 1000 / frames_total);
 
-            delete current_project;
-            current_project = nullptr;
+        double frames_per_second = runner->getFramesPerSecond();
+        int seconds_left = frames_per_second > 0 ? (int)((frames_total - frames_done) / frames_per_second) : 0;
+        int minutes_left = seconds_left / 60;
+        seconds_left = seconds_left % 60;
+        int hours_left = minutes_left / 60;
+        minutes_left = minutes_left % 60;
 
-            QMetaObject::invokeMethod(this, "errorPopup", Qt::QueuedConnection, Q_ARG(QString, QStringLiteral("Job number %1: failed to retrieve frame number %2. Error message:\n\n%3").arg(current_job).arg(n).arg(error_msg)));
-        }
+        text += QStringLiteral("\n\nJob %1: %2\n%3%, %4 fps, %5:%6:%7 to finish")
+                .arg(runner->getJobIndex() + 1)
+                .arg(QString::fromStdString(jobs[runner->getJobIndex()].getOutputFile()))
+                .arg((int64_t)frames_done * 100 / frames_total)
+                .arg(frames_per_second, 0, 'f', 2)
+                .arg(hours_left, 2, 10, QLatin1Char('0'))
+                .arg(minutes_left, 2, 10, QLatin1Char('0'))
+                .arg(seconds_left, 2, 10, QLatin1Char('0'));
     }
 
-    --request_count;
-
-    if (request_count == 0) {
-        std::lock_guard<std::mutex> lock(requests_mutex);
-        requests_condition.notify_one();
-    }
+    main_progress_dialog->setLabelText(text);
+    main_progress_dialog->setValue(value);
 }
 
 
@@ -1607,9 +1533,23 @@ void WibblyWindow::readSettings() {
 
     settings_use_relative_paths_check->setChecked(settings.value(KEY_USE_RELATIVE_PATHS, false).toBool());
 
+    settings_binary_columns_check->setChecked(settings.value(KEY_BINARY_COLUMNS, false).toBool());
+
     if (settings.contains(KEY_MAXIMUM_CACHE_SIZE))
         settings_cache_spin->setValue(settings.value(KEY_MAXIMUM_CACHE_SIZE).toInt());
 
+    if (settings.contains(KEY_CONCURRENT_JOBS))
+        settings_concurrent_jobs_spin->setValue(settings.value(KEY_CONCURRENT_JOBS).toInt());
+
+    if (settings.contains(KEY_FRAME_REQUESTS))
+        settings_frame_requests_spin->setValue(settings.value(KEY_FRAME_REQUESTS).toInt());
+
+    if (settings.contains(KEY_JOB_FRAME_REQUESTS))
+        settings_job_frame_requests_spin->setValue(settings.value(KEY_JOB_FRAME_REQUESTS).toInt());
+
+    if (settings.contains(KEY_JOB_CHUNKS))
+        settings_job_chunks_spin->setValue(settings.value(KEY_JOB_CHUNKS).toInt());
+
     if (settings.contains(KEY_LAST_CROP)) {
         QList<QVariant> crop_list = settings.value(KEY_LAST_CROP).toList();
         for (int i = 0; i < crop_list.size(); i++)
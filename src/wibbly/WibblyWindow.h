@@ -21,12 +21,10 @@ SOFTWARE.
 #ifndef WIBBLYWINDOW_H
 #define WIBBLYWINDOW_H
 
-#include <atomic>
-
 #include <QCheckBox>
 #include <QCloseEvent>
 #include <QDoubleSpinBox>
-#include <QElapsedTimer>
+#include <QImage>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMainWindow>
@@ -34,6 +32,7 @@ SOFTWARE.
 #include <QSlider>
 #include <QSpinBox>
 #include <QTimeEdit>
+#include <QTimer>
 
 #include <VSScript4.h>
 
@@ -42,13 +41,7 @@ SOFTWARE.
 #include "ProgressDialog.h"
 
 #include "WibblyJob.h"
-
-
-enum VIVTCParameterTypes {
-    VIVTCParamInt,
-    VIVTCParamDouble,
-    VIVTCParamBool
-};
+#include "WibblyJobRunner.h"
 
 
 struct VIVTCParameter {
@@ -102,7 +95,12 @@ class WibblyWindow : public QMainWindow
     QSpinBox *settings_font_spin;
     QCheckBox *settings_compact_projects_check;
     QCheckBox *settings_use_relative_paths_check;
+    QCheckBox *settings_binary_columns_check;
     QSpinBox *settings_cache_spin;
+    QSpinBox *settings_concurrent_jobs_spin;
+    QSpinBox *settings_frame_requests_spin;
+    QSpinBox *settings_job_frame_requests_spin;
+    QSpinBox *settings_job_chunks_spin;
     int settings_last_crop[4] = {};
 
 
@@ -119,20 +117,15 @@ class WibblyWindow : public QMainWindow
     std::vector<WibblyJob> jobs;
 
     int current_frame = 0;
+    QImage frame_image; // Reused by displayFrame, so each frame doesn't need a new buffer.
 
     int trim_start = -1;
     int trim_end = -1;
 
-    WobblyProject *current_project = nullptr;
-    int current_job = -1;
-    int next_frame = 0;
-    int frames_left = 0;
-    bool aborted = false;
-    std::atomic<int> request_count;
+    WibblyJobQueue *job_queue = nullptr; // nullptr when no jobs are running.
+    QString job_errors;
 
-    QString progress_dialog_label_text;
-    QElapsedTimer elapsed_timer;
-    QElapsedTimer update_timer;
+    QTimer *progress_timer;
 
     QSettings settings;
 
@@ -159,6 +152,11 @@ class WibblyWindow : public QMainWindow
 
     void realOpenVideo(const QString &path);
 
+    void startJobs();
+    void stopJobs();
+    void finishJobs();
+    void updateProgress();
+
     void evaluateFinalScript(int job_index);
     void evaluateDisplayScript();
     void displayFrame(int n);
@@ -191,9 +189,6 @@ public:
 
 public slots:
     void vsLogPopup(int msgType, const QString &msg);
-    void frameDone(void *frame_v, int n, const QString &error_msg);
-
-    void startNextJob();
 
     void errorPopup(const QString &msg);
 };
@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#include "FrameCache.h"
+
+
+FrameCache::FrameCache(size_t _max_size)
+    : max_size(_max_size)
+{
+
+}
+
+
+void FrameCache::shrink() {
+    while (size > max_size && !entries.empty()) {
+        size -= entries.back().size;
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+
+const CachedFrame *FrameCache::find(int generation, int frame) {
+    auto it = index.find(Key(generation, frame));
+    if (it == index.cend())
+        return nullptr;
+
+    entries.splice(entries.begin(), entries, it->second);
+
+    return &it->second->frame;
+}
+
+
+bool FrameCache::contains(int generation, int frame) const {
+    return index.count(Key(generation, frame));
+}
+
+
+void FrameCache::insert(int generation, int frame, const CachedFrame &cached) {
+    Key key(generation, frame);
+
+    auto it = index.find(key);
+    if (it != index.end()) {
+        size -= it->second->size;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    size_t frame_size = (size_t)cached.image.bytesPerLine() * cached.image.height();
+
+    // Bigger than the whole cache.
+    if (frame_size > max_size)
+        return;
+
+    entries.push_front({ key, cached, frame_size });
+    index.insert({ key, entries.begin() });
+    size += frame_size;
+
+    shrink();
+}
+
+
+void FrameCache::removeGeneration(int generation) {
+    auto first = index.lower_bound(Key(generation, 0));
+    auto last = index.lower_bound(Key(generation + 1, 0));
+
+    for (auto it = first; it != last; it++) {
+        size -= it->second->size;
+        entries.erase(it->second);
+    }
+
+    index.erase(first, last);
+}
+
+
+void FrameCache::renameGeneration(int old_generation, int new_generation, int first_dropped, int last_dropped) {
+    auto it = index.lower_bound(Key(old_generation, 0));
+
+    while (it != index.end() && it->first.first == old_generation) {
+        auto node = index.extract(it++);
+
+        int frame = node.key().second;
+
+        if (frame >= first_dropped && frame <= last_dropped) {
+            size -= node.mapped()->size;
+            entries.erase(node.mapped());
+            continue;
+        }
+
+        node.key() = Key(new_generation, frame);
+        node.mapped()->key = node.key();
+        index.insert(std::move(node));
+    }
+}
+
+
+void FrameCache::clear() {
+    entries.clear();
+    index.clear();
+    size = 0;
+}
+
+
+size_t FrameCache::getSize() const {
+    return size;
+}
+
+
+size_t FrameCache::getMaximumSize() const {
+    return max_size;
+}
+
+
+void FrameCache::setMaximumSize(size_t new_max_size) {
+    max_size = new_max_size;
+
+    shrink();
+}
@@ -0,0 +1,86 @@
+/*
+
+Copyright (c) 2015, John Smith
+
+Permission to use, copy, modify, and/or distribute this software for
+any purpose with or without fee is hereby granted, provided that the
+above copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+SOFTWARE.
+
+*/
+
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QImage>
+#include <QString>
+
+#include <list>
+#include <map>
+#include <utility>
+
+
+struct CachedFrame {
+    QImage image; // Packed RGB, as returned by packRGBFrame.
+    QString pict_type;
+};
+
+
+// Frames already shown by the viewer, so stepping back and forth doesn't
+// request them from VapourSynth and pack them again.
+// Frames are identified by the generation of the node that produced them
+// and their number. The least recently used frames are dropped first.
+class FrameCache {
+    typedef std::pair<int, int> Key; // Generation, frame number.
+
+    struct Entry {
+        Key key;
+        CachedFrame frame;
+        size_t size;
+    };
+
+    std::list<Entry> entries; // Most recently used first.
+    std::map<Key, std::list<Entry>::iterator> index;
+
+    size_t size = 0;
+    size_t max_size;
+
+    void shrink();
+
+public:
+    explicit FrameCache(size_t _max_size = 0);
+
+    // Returns nullptr if the frame isn't cached. The pointer is valid until the next insertion.
+    const CachedFrame *find(int generation, int frame);
+
+    // Doesn't count as a use.
+    bool contains(int generation, int frame) const;
+
+    void insert(int generation, int frame, const CachedFrame &cached);
+
+    // Drops the frames of a node that was replaced.
+    void removeGeneration(int generation);
+
+    // Hands the frames of a replaced node over to the node that replaced
+    // it, except the frames from first_dropped to last_dropped, which the
+    // new node doesn't show the same way.
+    void renameGeneration(int old_generation, int new_generation, int first_dropped, int last_dropped);
+
+    void clear();
+
+    size_t getSize() const;
+
+    size_t getMaximumSize() const;
+    void setMaximumSize(size_t new_max_size);
+};
+
+#endif // FRAMECACHE_H
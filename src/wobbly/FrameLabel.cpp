@@ -18,14 +18,108 @@ SOFTWARE.
 */
 
 
+#include <QPaintEvent>
+#include <QPainter>
+
 #include "FrameLabel.h"
 
 void FrameLabel::setPixmap(const QPixmap &new_pixmap) {
-    QLabel::setPixmap(new_pixmap);
+    m_pixmap = new_pixmap;
+
+    updatePixmapSize();
+
+    update();
+}
+
 
-    if (m_pixmap_size != new_pixmap.size()) {
-        m_pixmap_size = new_pixmap.size();
+const QPixmap &FrameLabel::framePixmap() const {
+    return m_pixmap;
+}
+
+
+void FrameLabel::setZoom(int zoom) {
+    if (m_zoom == zoom)
+        return;
+
+    m_zoom = zoom;
+
+    updatePixmapSize();
+
+    update();
+}
+
+
+void FrameLabel::updatePixmapSize() {
+    QSize new_size = m_pixmap.size() * m_zoom;
+
+    if (m_pixmap_size != new_size) {
+        m_pixmap_size = new_size;
+
+        // The scroll area needs to know.
+        updateGeometry();
 
         emit pixmapSizeChanged(m_pixmap_size);
     }
 }
+
+
+void FrameLabel::setCropOverlay(const QMargins &margins) {
+    if (m_crop_overlay == margins)
+        return;
+
+    m_crop_overlay = margins;
+
+    update();
+}
+
+
+QSize FrameLabel::sizeHint() const {
+    return m_pixmap_size;
+}
+
+
+QSize FrameLabel::minimumSizeHint() const {
+    return m_pixmap_size;
+}
+
+
+void FrameLabel::paintEvent(QPaintEvent *e) {
+    QLabel::paintEvent(e);
+
+    if (m_pixmap.isNull())
+        return;
+
+    // The pixmap is centered.
+    QRect frame_rect(QPoint(std::max(0, width() - m_pixmap_size.width()) / 2,
+                            std::max(0, height() - m_pixmap_size.height()) / 2),
+                     m_pixmap_size);
+
+    // Inside a scroll area, only the visible part is exposed.
+    QRect exposed = e->rect() & frame_rect;
+    if (exposed.isEmpty())
+        return;
+
+    // Whole pixmap pixels covering the exposed part.
+    QRect source(QPoint((exposed.left() - frame_rect.left()) / m_zoom,
+                        (exposed.top() - frame_rect.top()) / m_zoom),
+                 QPoint((exposed.right() - frame_rect.left()) / m_zoom,
+                        (exposed.bottom() - frame_rect.top()) / m_zoom));
+
+    QRect target(frame_rect.topLeft() + source.topLeft() * m_zoom, source.size() * m_zoom);
+
+    QPainter paint(this);
+
+    // Nearest neighbour, so that every pixel stays visible when zoomed in.
+    paint.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    paint.drawPixmap(target, m_pixmap, source);
+
+    if (m_crop_overlay.isNull())
+        return;
+
+    QMargins crop_overlay = m_crop_overlay * m_zoom;
+
+    QRegion cropped = QRegion(frame_rect) - QRegion(frame_rect.marginsRemoved(crop_overlay));
+
+    for (const QRect &rect : cropped & exposed)
+        paint.fillRect(rect, QColor(224, 81, 255));
+}
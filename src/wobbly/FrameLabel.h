@@ -22,6 +22,7 @@ SOFTWARE.
 #define FRAMELABEL_H
 
 #include <QLabel>
+#include <QMargins>
 
 
 class FrameLabel : public QLabel {
@@ -30,13 +31,32 @@ class FrameLabel : public QLabel {
 public:
     using QLabel::QLabel;
 
+    // The pixmap is kept at its own resolution and magnified when painted.
     void setPixmap(const QPixmap &new_pixmap);
+    const QPixmap &framePixmap() const;
+
+    void setZoom(int zoom);
+
+    // Paints over the edges of the pixmap that would be cropped. In pixmap pixels, before the zoom.
+    // Null margins paint nothing.
+    void setCropOverlay(const QMargins &margins);
+
+    QSize sizeHint() const;
+    QSize minimumSizeHint() const;
 
 signals:
+    // The size on screen, after the zoom.
     void pixmapSizeChanged(QSize new_size);
 
 private:
+    void paintEvent(QPaintEvent *e);
+
+    void updatePixmapSize();
+
+    QPixmap m_pixmap;
+    int m_zoom = 1;
     QSize m_pixmap_size;
+    QMargins m_crop_overlay;
 };
 
 #endif // FRAMELABEL_H
@@ -37,6 +37,7 @@ SOFTWARE.
 #include <QSpinBox>
 #include <QStatusBar>
 #include <QTabWidget>
+#include <QRunnable>
 #include <QThread>
 #include <QClipboard>
 #include <QDir>
@@ -50,6 +51,7 @@ SOFTWARE.
 #include "RandomStuff.h"
 #include "ScrollArea.h"
 #include "WobblyException.h"
+#include "WobblyFilters.h"
 #include "WobblyWindow.h"
 #include "WobblyShared.h"
 
@@ -65,8 +67,11 @@ SOFTWARE.
 #define KEY_ASK_FOR_BOOKMARK_DESCRIPTION    QStringLiteral("user_interface/ask_for_bookmark_description")
 #define KEY_COLORMATRIX                     QStringLiteral("user_interface/colormatrix")
 #define KEY_MAXIMUM_CACHE_SIZE              QStringLiteral("user_interface/maximum_cache_size")
+#define KEY_FRAME_CACHE_SIZE                QStringLiteral("user_interface/frame_cache_size")
+#define KEY_READ_AHEAD                      QStringLiteral("user_interface/read_ahead")
 #define KEY_PRINT_DETAILS_ON_VIDEO          QStringLiteral("user_interface/print_details_on_video")
 #define KEY_UNDO_STEPS                      QStringLiteral("user_interface/undo_steps")
+#define KEY_UNDO_MEMORY_BUDGET              QStringLiteral("user_interface/undo_memory_budget")
 #define KEY_NUMBER_OF_THUMBNAILS            QStringLiteral("user_interface/number_of_thumbnails")
 #define KEY_THUMBNAIL_SIZE                  QStringLiteral("user_interface/thumbnail_size")
 #define KEY_LAST_DIR                        QStringLiteral("user_interface/last_dir")
@@ -75,6 +80,8 @@ SOFTWARE.
 
 #define KEY_COMPACT_PROJECT_FILES           QStringLiteral("projects/compact_project_files")
 #define KEY_USE_RELATIVE_PATHS              QStringLiteral("projects/use_relative_paths")
+#define KEY_BINARY_COLUMNS                  QStringLiteral("projects/binary_columns")
+#define KEY_AUTOSAVE_INTERVAL               QStringLiteral("projects/autosave_interval")
 #define KEY_DECIMATION_FUNCTION             QStringLiteral("projects/decimation_function")
 
 
@@ -82,12 +89,16 @@ struct CallbackData {
     WobblyWindow *window;
     VSNode *node;
     bool preview_node;
+    bool thumbnail;
+    int generation;
     const VSAPI *vsapi;
 
-    CallbackData(WobblyWindow *_window, VSNode *_node, bool _preview_node, const VSAPI *_vsapi)
+    CallbackData(WobblyWindow *_window, VSNode *_node, bool _preview_node, bool _thumbnail, int _generation, const VSAPI *_vsapi)
         : window(_window)
         , node(_node)
         , preview_node(_preview_node)
+        , thumbnail(_thumbnail)
+        , generation(_generation)
         , vsapi(_vsapi)
     {
 
@@ -95,6 +106,55 @@ struct CallbackData {
 };
 
 
+// Runs in pack_pool. Hands the images to WobblyWindow::frameReady.
+struct PackTask : public QRunnable {
+    WobblyWindow *window;
+    const VSAPI *vsapi;
+    const VSFrame *frame;
+    int n;
+    bool preview_node;
+    bool thumbnail;
+    int generation;
+    QSize thumbnail_size; // Only used if the thumbnail node couldn't do the scaling.
+
+    PackTask(WobblyWindow *_window, const VSAPI *_vsapi, const VSFrame *_frame, int _n, bool _preview_node, bool _thumbnail, int _generation, QSize _thumbnail_size)
+        : window(_window)
+        , vsapi(_vsapi)
+        , frame(_frame)
+        , n(_n)
+        , preview_node(_preview_node)
+        , thumbnail(_thumbnail)
+        , generation(_generation)
+        , thumbnail_size(_thumbnail_size)
+    {
+
+    }
+
+    void run() {
+        // error pointer must be non-null to enable non-exceptional return in case of missing/bad property
+        int pict_type_error;
+        const char *pict_type_data = vsapi->mapGetData(vsapi->getFramePropertiesRO(frame), "_PictType", 0, &pict_type_error);
+        QString pict_type(pict_type_data ? pict_type_data : "&lt;unknown&gt;");
+
+        QImage image(vsapi->getFrameWidth(frame, 0), vsapi->getFrameHeight(frame, 0), QImage::Format_RGB32);
+        packRGBFrame(vsapi, frame, image.bits(), image.bytesPerLine());
+        vsapi->freeFrame(frame);
+
+        // Clips with variable dimensions, or the screen changed.
+        if (thumbnail && image.size() != thumbnail_size)
+            image = image.scaled(thumbnail_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+        QMetaObject::invokeMethod(window, "frameReady", Qt::QueuedConnection,
+                                  Q_ARG(int, n),
+                                  Q_ARG(bool, preview_node),
+                                  Q_ARG(bool, thumbnail),
+                                  Q_ARG(int, generation),
+                                  Q_ARG(QImage, image),
+                                  Q_ARG(QString, pict_type));
+    }
+};
+
+
 WobblyWindow::WobblyWindow()
     : QMainWindow()
     , splash_image(720, 480, QImage::Format_RGB32)
@@ -109,6 +169,8 @@ WobblyWindow::WobblyWindow()
 
     readSettings();
 
+    pack_pool.setMaxThreadCount(std::max(1, std::min(4, QThread::idealThreadCount() / 2)));
+
     try {
         initialiseVapourSynth();
     } catch (WobblyException &e) {
@@ -175,6 +237,8 @@ void WobblyWindow::readSettings() {
 
     settings_use_relative_paths_check->setChecked(settings.value(KEY_USE_RELATIVE_PATHS, false).toBool());
 
+    settings_binary_columns_check->setChecked(settings.value(KEY_BINARY_COLUMNS, false).toBool());
+
     settings_bookmark_description_check->setChecked(settings.value(KEY_ASK_FOR_BOOKMARK_DESCRIPTION, true).toBool());
 
     settings_decimation_function_combo->setCurrentText(settings.value(KEY_DECIMATION_FUNCTION, "Auto").toString());
@@ -183,10 +247,20 @@ void WobblyWindow::readSettings() {
 
     settings_cache_spin->setValue(settings.value(KEY_MAXIMUM_CACHE_SIZE, 4096).toInt());
 
+    settings_frame_cache_spin->setValue(settings.value(KEY_FRAME_CACHE_SIZE, 256).toInt());
+    // valueChanged isn't emitted if the value was already the default.
+    frame_cache.setMaximumSize(size_t(settings_frame_cache_spin->value()) * 1024 * 1024);
+
+    settings_read_ahead_spin->setValue(settings.value(KEY_READ_AHEAD, 4).toInt());
+
     settings_print_details_check->setChecked(settings.value(KEY_PRINT_DETAILS_ON_VIDEO, true).toBool());
 
     settings_undo_steps_spin->setValue(settings.value(KEY_UNDO_STEPS, 50).toInt());
 
+    settings_undo_memory_spin->setValue(settings.value(KEY_UNDO_MEMORY_BUDGET, 512).toInt());
+
+    settings_autosave_spin->setValue(settings.value(KEY_AUTOSAVE_INTERVAL, 0).toInt());
+
     settings_num_thumbnails_spin->setValue(settings.value(KEY_NUMBER_OF_THUMBNAILS, 5).toInt());
 
     settings_thumbnail_size_dspin->setValue(settings.value(KEY_THUMBNAIL_SIZE, 15).toDouble());
@@ -238,6 +312,8 @@ void WobblyWindow::closeEvent(QCloseEvent *event) {
         return;
     }
 
+    waitForSave();
+
     writeSettings();
 
     cleanUpVapourSynth();
@@ -601,6 +677,10 @@ void WobblyWindow::createCropAssistant() {
 
     crop_early_check = new QCheckBox("Crop early");
 
+    crop_timer = new QTimer(this);
+    crop_timer->setSingleShot(true);
+    crop_timer->setInterval(500);
+
     const char *resize_prefixes[2] = {
         "Width: ",
         "Height: "
@@ -663,27 +743,60 @@ void WobblyWindow::createCropAssistant() {
 
         project->setCropEnabled(checked);
 
-        try {
-            evaluateScript(preview);
-        } catch (WobblyException &) {
+        updateCropOverlay();
+
+        if (preview) {
+            try {
+                evaluateFinalScript();
+            } catch (WobblyException &) {
 
+            }
         }
     });
 
+    // The source view only paints the crop over the frame, which is instant.
+    // The preview must run the final script again, which can take a while,
+    // so it waits until the values stop changing.
     auto cropChanged = [this] () {
         if (!project)
             return;
 
         project->setCrop(crop_spin[0]->value(), crop_spin[1]->value(), crop_spin[2]->value(), crop_spin[3]->value());
 
+        updateCropOverlay();
+
+        if (preview)
+            crop_timer->start();
+    };
+
+    auto cropFinished = [this] () {
+        if (!crop_timer->isActive())
+            return;
+
+        crop_timer->stop();
+
         try {
-            evaluateScript(preview);
+            evaluateFinalScript();
         } catch (WobblyException &) {
 
         }
     };
-    for (int i = 0; i < 4; i++)
+
+    for (int i = 0; i < 4; i++) {
         connect(crop_spin[i], static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), cropChanged);
+        connect(crop_spin[i], &QSpinBox::editingFinished, cropFinished);
+    }
+
+    connect(crop_timer, &QTimer::timeout, [this] () {
+        if (!project || !preview)
+            return;
+
+        try {
+            evaluateFinalScript();
+        } catch (WobblyException &) {
+
+        }
+    });
 
     connect(crop_early_check, &QCheckBox::clicked, [this] (bool checked) {
         if (!project)
@@ -2601,10 +2714,14 @@ void WobblyWindow::createCombedFramesWindow() {
         });
 
         connect(collector, &CombedFramesCollector::combedFramesCollected, [this] (const std::set<int> &combed_frames) {
-            project->clearCombedFrames();
+            {
+                BulkUpdate bulk_update(project);
+
+                project->clearCombedFrames();
 
-            for (auto it = combed_frames.cbegin(); it != combed_frames.cend(); it++)
-                project->addCombedFrame(project->frameNumberBeforeDecimation(*it));
+                for (auto it = combed_frames.cbegin(); it != combed_frames.cend(); it++)
+                    project->addCombedFrame(project->frameNumberBeforeDecimation(*it));
+            }
 
             commit("Find combed frames");
             updateFrameDetails();
@@ -2759,6 +2876,8 @@ void WobblyWindow::createSettingsWindow() {
 
     settings_use_relative_paths_check = new QCheckBox(QStringLiteral("Use relative paths in project files"));
 
+    settings_binary_columns_check = new QCheckBox(QStringLiteral("Store per-frame data in a binary file next to the project"));
+
     settings_print_details_check = new QCheckBox(QStringLiteral("Print frame details on top of the video"));
 
     settings_bookmark_description_check = new QCheckBox(QStringLiteral("Ask for bookmark description"));
@@ -2790,9 +2909,33 @@ void WobblyWindow::createSettingsWindow() {
     settings_cache_spin->setValue(4096);
     settings_cache_spin->setSuffix(QStringLiteral(" MiB"));
 
+    settings_frame_cache_spin = new QSpinBox;
+    settings_frame_cache_spin->setRange(0, 99999);
+    settings_frame_cache_spin->setValue(256);
+    settings_frame_cache_spin->setSuffix(QStringLiteral(" MiB"));
+    settings_frame_cache_spin->setToolTip(QStringLiteral("Memory used to keep the frames and thumbnails already displayed."));
+
+    settings_read_ahead_spin = new QSpinBox;
+    settings_read_ahead_spin->setRange(0, 100);
+    settings_read_ahead_spin->setValue(4);
+    settings_read_ahead_spin->setSuffix(QStringLiteral(" steps"));
+    settings_read_ahead_spin->setToolTip(QStringLiteral("When stepping through the video repeatedly by the same amount, the frames for this many of the next steps are requested in advance."));
+
     settings_undo_steps_spin = new SpinBox;
     settings_undo_steps_spin->setRange(0, 1000);
 
+    settings_undo_memory_spin = new QSpinBox;
+    settings_undo_memory_spin->setRange(1, 99999);
+    settings_undo_memory_spin->setValue(512);
+    settings_undo_memory_spin->setSuffix(QStringLiteral(" MiB"));
+
+    settings_undo_memory_label = new QLabel(QStringLiteral("none"));
+
+    settings_autosave_spin = new QSpinBox;
+    settings_autosave_spin->setRange(0, 999);
+    settings_autosave_spin->setSuffix(QStringLiteral(" min"));
+    settings_autosave_spin->setSpecialValueText(QStringLiteral("never"));
+
     settings_num_thumbnails_spin = new SpinBox;
     settings_num_thumbnails_spin->setRange(-1, 21);
     settings_num_thumbnails_spin->setSingleStep(2);
@@ -2820,6 +2963,19 @@ void WobblyWindow::createSettingsWindow() {
         settings.setValue(KEY_USE_RELATIVE_PATHS, checked);
     });
 
+    connect(settings_binary_columns_check, &QCheckBox::toggled, [this] (bool checked) {
+        settings.setValue(KEY_BINARY_COLUMNS, checked);
+    });
+
+    connect(settings_autosave_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_AUTOSAVE_INTERVAL, value);
+
+        if (value)
+            autosave_timer->start(value * 60000);
+        else
+            autosave_timer->stop();
+    });
+
     connect(settings_print_details_check, &QCheckBox::toggled, [this] (bool checked) {
         settings.setValue(KEY_PRINT_DETAILS_ON_VIDEO, checked);
 
@@ -2882,10 +3038,29 @@ void WobblyWindow::createSettingsWindow() {
         settings.setValue(KEY_MAXIMUM_CACHE_SIZE, value);
     });
 
+    connect(settings_frame_cache_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        frame_cache.setMaximumSize(size_t(value) * 1024 * 1024);
+        settings.setValue(KEY_FRAME_CACHE_SIZE, value);
+    });
+
+    connect(settings_read_ahead_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        settings.setValue(KEY_READ_AHEAD, value);
+    });
+
     connect(settings_undo_steps_spin, static_cast<void (SpinBox::*)(int)>(&SpinBox::valueChanged), [this] (int value) {
         if (project)
             project->setUndoSteps(size_t(value));
         settings.setValue(KEY_UNDO_STEPS, value);
+
+        updateUndoActions();
+    });
+
+    connect(settings_undo_memory_spin, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [this] (int value) {
+        if (project)
+            project->setUndoMemoryBudget(size_t(value) * 1024 * 1024);
+        settings.setValue(KEY_UNDO_MEMORY_BUDGET, value);
+
+        updateUndoActions();
     });
 
     connect(settings_num_thumbnails_spin, static_cast<void (SpinBox::*)(int)>(&SpinBox::valueChanged), [this] (int num_thumbnails) {
@@ -2921,7 +3096,12 @@ void WobblyWindow::createSettingsWindow() {
 
         if (num_thumbnails > 0) {
             if (project) {
-                requestFrames(current_frame);
+                // The thumbnail nodes have the old size.
+                try {
+                    evaluateScript(preview);
+                } catch (WobblyException &e) {
+                    errorPopup(e.what());
+                }
             } else {
                 int first_visible = (MAX_THUMBNAILS - num_thumbnails) / 2;
                 int last_visible = first_visible + num_thumbnails - 1;
@@ -2997,6 +3177,7 @@ void WobblyWindow::createSettingsWindow() {
     QFormLayout *form = new QFormLayout;
     form->addRow(settings_compact_projects_check);
     form->addRow(settings_use_relative_paths_check);
+    form->addRow(settings_binary_columns_check);
     form->addRow(settings_print_details_check);
     form->addRow(settings_bookmark_description_check);
     form->addRow(QStringLiteral("Decimation function"), settings_decimation_function_combo);
@@ -3005,7 +3186,12 @@ void WobblyWindow::createSettingsWindow() {
     form->addRow(QStringLiteral("Application style"), application_style_combo);
     form->addRow(QStringLiteral("Colormatrix"), settings_colormatrix_combo);
     form->addRow(QStringLiteral("Maximum cache size"), settings_cache_spin);
+    form->addRow(QStringLiteral("Viewer frame cache size"), settings_frame_cache_spin);
+    form->addRow(QStringLiteral("Read-ahead"), settings_read_ahead_spin);
     form->addRow(QStringLiteral("Maximum undo steps"), settings_undo_steps_spin);
+    form->addRow(QStringLiteral("Maximum undo memory"), settings_undo_memory_spin);
+    form->addRow(QStringLiteral("Undo memory in use"), settings_undo_memory_label);
+    form->addRow(QStringLiteral("Autosave interval"), settings_autosave_spin);
     form->addRow(QStringLiteral("Number of thumbnails"), settings_num_thumbnails_spin);
     form->addRow(QStringLiteral("Thumbnail size"), settings_thumbnail_size_dspin);
 
@@ -3148,6 +3334,13 @@ void WobblyWindow::createUI() {
 
     statusBar()->setSizeGripEnabled(true);
 
+    saving_label = new QLabel;
+    saving_label->hide();
+    statusBar()->addPermanentWidget(saving_label);
+
+    autosave_timer = new QTimer(this);
+    connect(autosave_timer, &QTimer::timeout, this, &WobblyWindow::autosave);
+
     selected_preset_label = new QLabel(QStringLiteral("Selected preset: "));
     selected_custom_list_label = new QLabel(QStringLiteral("Selected custom list: "));
     zoom_label = new QLabel(QStringLiteral("Zoom: 1x"));
@@ -3200,9 +3393,41 @@ void WobblyWindow::createUI() {
         if (!project)
             return;
 
+        scrub_timer->stop();
+
         requestFrames(value);
     });
 
+    // While the slider is dragged, the frames under it are displayed
+    // as fast as they can be retrieved, but the positions it passes
+    // in between are merged.
+    scrub_timer = new QTimer(this);
+    scrub_timer->setSingleShot(true);
+    scrub_timer->setInterval(30);
+
+    connect(scrub_timer, &QTimer::timeout, [this] () {
+        if (!project)
+            return;
+
+        requestFrames(frame_slider->sliderPosition());
+    });
+
+    connect(frame_slider, &QSlider::sliderMoved, [this] () {
+        if (project && !scrub_timer->isActive())
+            scrub_timer->start();
+    });
+
+    connect(frame_slider, &QSlider::sliderReleased, [this] () {
+        if (!project)
+            return;
+
+        scrub_timer->stop();
+
+        // valueChanged isn't emitted if the last position was already displayed.
+        if (frame_slider->sliderPosition() != current_frame)
+            requestFrames(frame_slider->sliderPosition());
+    });
+
 
     QVBoxLayout *vbox = new QVBoxLayout;
     vbox->addWidget(tab_bar);
@@ -3281,6 +3506,7 @@ void WobblyWindow::vsLogPopup(int msgType, const QString &msg) {
                 project_path = video_path + ".wob";
 
             realSaveProject(project_path);
+            waitForSave();
 
             message += "Your work has been saved to '" + project_path + "'. ";
         }
@@ -3338,15 +3564,31 @@ void WobblyWindow::initialiseVapourSynth() {
 
 
 void WobblyWindow::cleanUpVapourSynth() {
+    // The tasks still hold frames.
+    pack_pool.waitForDone();
+
     frame_label->setPixmap(QPixmap());
     for (int i = 0; i < MAX_THUMBNAILS; i++)
         thumb_labels[i]->setPixmap(QPixmap());
 
     for (int i = 0; i < 2; i++) {
-        vsapi->freeNode(vsnode[i]);
-        vsnode[i] = nullptr;
+        setDisplayNode(i, false, nullptr);
+        setDisplayNode(i, true, nullptr);
     }
 
+    frame_cache.clear();
+    frames_in_flight.clear();
+    last_requested_frame = -1;
+    last_stride = 0;
+    read_ahead_stride = 0;
+    evaluated_final_script.clear();
+    final_display_matrix.clear();
+    final_display_thumbnail_size = QSize();
+    main_display_matrix.clear();
+    main_display_thumbnail_size = QSize();
+
+    resetMainDisplaySource();
+
     vssapi->freeScript(vsscript);
     vsscript = nullptr;
     vscore = nullptr;
@@ -3421,16 +3663,7 @@ void WobblyWindow::initialiseCropAssistant() {
     depth_dither_combo->setCurrentIndex(dither_to_index[depth.dither]);
 
 
-    connect(crop_dock, &DockWidget::visibilityChanged, [this] {
-        if (!project)
-            return;
-
-        try {
-            evaluateMainDisplayScript();
-        } catch (WobblyException &) {
-
-        }
-    });
+    connect(crop_dock, &DockWidget::visibilityChanged, this, &WobblyWindow::updateCropOverlay);
 }
 
 
@@ -3781,10 +4014,12 @@ void WobblyWindow::initialiseUIFromProject() {
 
     // Zoom.
     zoom_label->setText(QStringLiteral("Zoom: %1x").arg(project->getZoom()));
+    frame_label->setZoom(project->getZoom());
 
     updateGeometry();
 
     project->setUndoSteps(size_t(settings.value(KEY_UNDO_STEPS, 50).toInt()));
+    project->setUndoMemoryBudget(size_t(settings.value(KEY_UNDO_MEMORY_BUDGET, 512).toInt()) * 1024 * 1024);
     project->updateOrphanFields();
 
     initialiseCropAssistant();
@@ -3805,6 +4040,9 @@ void WobblyWindow::initialiseUIFromProject() {
 
 
 void WobblyWindow::realOpenProject(const QString &path) {
+    waitForSave();
+    autosave_modification_count = 0;
+
     WobblyProject *tmp = new WobblyProject(true);
 
     try {
@@ -3829,6 +4067,7 @@ void WobblyWindow::realOpenProject(const QString &path) {
         project->commit("Initial");
 
         vssapi->evaluateBuffer(vsscript, "vs.clear_output(1)", "wobbly.cleanup");
+        resetMainDisplaySource();
 
         connect(project, &WobblyProject::modifiedChanged, this, &WobblyWindow::updateWindowTitle);
 
@@ -3879,6 +4118,9 @@ const char *WobblyWindow::getArgsForSourceFilter(const QString &source_filter) {
 }
 
 void WobblyWindow::realOpenVideo(const QString &path) {
+    waitForSave();
+    autosave_modification_count = 0;
+
     try {
         QString source_filter;
 
@@ -3944,6 +4186,7 @@ void WobblyWindow::realOpenVideo(const QString &path) {
         project->commit("Initial");
 
         vssapi->evaluateBuffer(vsscript, "vs.clear_output(1)", "wobbly.cleanup");
+        resetMainDisplaySource();
 
         evaluateMainDisplayScript();
 
@@ -3974,8 +4217,21 @@ void WobblyWindow::realSaveProject(const QString &path) {
     if (!project)
         return;
 
+    // Saves happen in the order they were requested.
+    if (save_thread) {
+        queued_save_path = path;
+        return;
+    }
+
+    startSave(path, false);
+}
+
+
+void WobblyWindow::startSave(const QString &path, bool autosave) {
     // The currently selected preset might not have been stored in the project yet.
-    presetEdited();
+    // Autosaving shouldn't add undo steps while the user is typing.
+    if (!autosave)
+        presetEdited();
 
     project->setLastVisitedFrame(current_frame);
 
@@ -3984,24 +4240,104 @@ void WobblyWindow::realSaveProject(const QString &path) {
     project->setUIState(std::string(state.constData(), state.size()));
     project->setUIGeometry(std::string(geometry.constData(), geometry.size()));
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool compact_project = settings_compact_projects_check->isChecked();
+    bool binary_columns = settings_binary_columns_check->isChecked();
 
-    try {
-        project->writeProject(path.toStdString(), settings_compact_projects_check->isChecked());
-    } catch (WobblyException &e) {
-        QApplication::restoreOverrideCursor();
+    save_snapshot = project->snapshot();
+    save_path = path;
+    save_is_autosave = autosave;
+    save_modification_count = project->getModificationCount();
+    save_error.clear();
+
+    WobblyProject *snapshot = save_snapshot;
+    std::string path_string = path.toStdString();
+
+    save_thread = QThread::create([this, snapshot, path_string, compact_project, binary_columns] () {
+        try {
+            snapshot->writeProject(path_string, compact_project, binary_columns);
+        } catch (WobblyException &e) {
+            save_error = e.what();
+        } catch (std::bad_alloc &) {
+            save_error = "Ran out of memory while saving the project to '" + path_string + "'.";
+        } catch (std::exception &e) {
+            // Anything escaping a QThread::create function would terminate the program, unsaved project included.
+            save_error = "Couldn't save the project to '" + path_string + "': " + e.what();
+        } catch (...) {
+            save_error = "Couldn't save the project to '" + path_string + "' because of an unknown error.";
+        }
+    });
+
+    connect(save_thread, &QThread::finished, this, &WobblyWindow::finishSave);
+
+    saving_label->setText(autosave ? QStringLiteral("Autosaving...") : QStringLiteral("Saving..."));
+    saving_label->show();
+
+    save_thread->start();
+}
+
+
+void WobblyWindow::finishSave() {
+    // waitForSave may have finished this save already.
+    if (!save_thread || !save_thread->isFinished())
+        return;
+
+    save_thread->deleteLater();
+    save_thread = nullptr;
+
+    if (save_error.empty())
+        project->finishSnapshotSave(save_snapshot);
 
-        throw e;
+    delete save_snapshot;
+    save_snapshot = nullptr;
+
+    saving_label->hide();
+
+    if (save_error.size()) {
+        errorPopup(save_error.c_str());
+    } else if (save_is_autosave) {
+        autosave_modification_count = save_modification_count;
+    } else {
+        // Edits made during the save aren't in the file.
+        if (project->getModificationCount() == save_modification_count)
+            project->setModified(false);
+
+        project_path = save_path;
+        video_path.clear();
+
+        updateWindowTitle();
+
+        addRecentFile(save_path);
     }
 
-    QApplication::restoreOverrideCursor();
+    if (!queued_save_path.isEmpty()) {
+        QString path = queued_save_path;
+        queued_save_path.clear();
+
+        realSaveProject(path);
+    }
+}
 
-    project_path = path;
-    video_path.clear();
 
-    updateWindowTitle();
+void WobblyWindow::waitForSave() {
+    // finishSave may start a queued save.
+    while (save_thread) {
+        save_thread->wait();
 
-    addRecentFile(path);
+        finishSave();
+    }
+}
+
+
+void WobblyWindow::autosave() {
+    if (!project || save_thread || !project->isModified())
+        return;
+
+    if (project->getModificationCount() == autosave_modification_count)
+        return;
+
+    QString path = project_path.isEmpty() ? video_path + ".wob" : project_path;
+
+    startSave(path + ".autosave", true);
 }
 
 
@@ -4190,7 +4526,7 @@ void WobblyWindow::saveScreenshot() {
     if (!path.isNull()) {
         settings.setValue(KEY_LAST_DIR, QFileInfo(path).absolutePath());
 
-        frame_label->pixmap(Qt::ReturnByValue).scaled(original_frame_width, original_frame_height, Qt::IgnoreAspectRatio, Qt::FastTransformation).save(path, "png");
+        frame_label->framePixmap().save(path, "png");
     }
 }
 
@@ -4435,18 +4771,11 @@ void WobblyWindow::showHideFrameDetailsOnVideo() {
 }
 
 
-void WobblyWindow::evaluateScript(bool final_script) {
-    std::string script;
-
-    if (final_script)
-        script = project->generateFinalScript();
-    else
-        script = project->generateMainDisplayScript();
-
+void WobblyWindow::getDisplayColorimetry(std::string &matrix, std::string &transfer, std::string &primaries) const {
     QString m = settings_colormatrix_combo->currentText();
-    std::string matrix = "709";
-    std::string transfer = "709";
-    std::string primaries = "709";
+    matrix = "709";
+    transfer = "709";
+    primaries = "709";
 
     if (m == "BT 601") {
         matrix = "470bg";
@@ -4465,44 +4794,38 @@ void WobblyWindow::evaluateScript(bool final_script) {
         transfer = "709";
         primaries = "2020";
     }
+}
 
-    script +=
-            "src = vs.get_output(index=0)\n"
-
-            "if isinstance(src, vs.VideoOutputTuple):\n"
-            "    src = src[0]\n"
 
-            "if src.format is None:\n"
-            "    raise vs.Error('The output clip has unknown format. Wobbly cannot display such clips.')\n";
+void WobblyWindow::evaluateScript(bool final_script) {
+    if (!final_script) {
+        evaluateMainDisplayScript();
+        return;
+    }
 
-    if (crop_dock->isVisible() && project->isCropEnabled() && !final_script) {
-        script += "src = c.std.CropRel(clip=src, left=";
-        script += std::to_string(crop_spin[0]->value()) + ", top=";
-        script += std::to_string(crop_spin[1]->value()) + ", right=";
-        script += std::to_string(crop_spin[2]->value()) + ", bottom=";
-        script += std::to_string(crop_spin[3]->value()) + ")\n";
+    std::string script = project->generateFinalScript();
 
-        script +=
-                "src = c.resize.Bicubic(clip=src, format=vs.RGB24, dither_type='random', matrix_in_s='" + matrix + "', transfer_in_s='" + transfer + "', primaries_in_s='" + primaries + "')\n";
+    script +=
+            "c.max_cache_size = " + std::to_string(settings_cache_spin->value()) + "\n";
 
-        script += "src = c.std.AddBorders(clip=src, left=";
-        script += std::to_string(crop_spin[0]->value()) + ", top=";
-        script += std::to_string(crop_spin[1]->value()) + ", right=";
-        script += std::to_string(crop_spin[2]->value()) + ", bottom=";
-        script += std::to_string(crop_spin[3]->value()) + ", color=[224, 81, 255])\n";
+    std::string matrix, transfer, primaries;
+    getDisplayColorimetry(matrix, transfer, primaries);
 
-        script += "c.query_video_format(vs.GRAY, vs.INTEGER, 32, 0, 0)\n";
-    } else {
-        script +=
-            "c.query_video_format(vs.GRAY, vs.INTEGER, 32, 0, 0)\n"
-            "src = c.resize.Bicubic(clip=src, format=vs.RGB24, dither_type='random', matrix_in_s='" + matrix + "', transfer_in_s='" + transfer + "', primaries_in_s='" + primaries + "')\n";
-    }
+    // The thumbnail size is only known once the script is evaluated, so compare it afterwards.
+    bool nodes_changed = !vsnode[1] || !vsnode_thumbnails[1] || script != evaluated_final_script || matrix != final_display_matrix;
 
-    script +=
-            "src.set_output()\n";
+    if (!nodes_changed) {
+        const VSVideoInfo *vi = vsapi->getVideoInfo(vsnode[1]);
+        QSize thumbnail_size;
+        if (vi->width && vi->height)
+            thumbnail_size = getThumbnailSize(QSize(vi->width, vi->height));
 
-    script +=
-            "c.max_cache_size = " + std::to_string(settings_cache_spin->value()) + "\n";
+        // Nothing changed, so the frames already displayed are still good.
+        if (thumbnail_size == final_display_thumbnail_size) {
+            requestFrames(current_frame);
+            return;
+        }
+    }
 
     if (vssapi->evaluateBuffer(vsscript, script.c_str(), (project_path.isEmpty() ? video_path : project_path).toUtf8().constData())) {
         std::string error = vssapi->getError(vsscript);
@@ -4511,23 +4834,151 @@ void WobblyWindow::evaluateScript(bool final_script) {
         if (traceback != std::string::npos)
             error.insert(traceback, 1, '\n');
 
-        throw WobblyException("Failed to evaluate " + std::string(final_script ? "final" : "main display") + " script. Error message:\n" + error);
+        throw WobblyException("Failed to evaluate final script. Error message:\n" + error);
     }
 
-    int node_index = (int)final_script;
+    // The conversions for display are added here rather than in the script,
+    // because the script's other outputs are read back by the next evaluation.
+    VSNode *node = vssapi->getOutputNode(vsscript, 0);
+    if (!node)
+        throw WobblyException("Final script evaluated successfully, but no node found at output index 0.");
 
-    vsapi->freeNode(vsnode[node_index]);
+    const VSVideoInfo *vi = vsapi->getVideoInfo(node);
 
-    vsnode[node_index] = vssapi->getOutputNode(vsscript, 0);
-    if (!vsnode[node_index])
-        throw WobblyException(std::string(final_script ? "Final" : "Main display") + " script evaluated successfully, but no node found at output index 0.");
+    if (vi->format.colorFamily == cfUndefined) {
+        vsapi->freeNode(node);
+        throw WobblyException("The output clip has unknown format. Wobbly cannot display such clips.");
+    }
+
+    QSize thumbnail_size;
+    if (vi->width && vi->height)
+        thumbnail_size = getThumbnailSize(QSize(vi->width, vi->height));
+
+    try {
+        setDisplayNode(true, false, createDisplayNode(node, QSize()));
+
+        // Clips with variable dimensions are scaled by PackTask.
+        if (thumbnail_size.isValid())
+            setDisplayNode(true, true, createDisplayNode(node, thumbnail_size));
+        else
+            setDisplayNode(true, true, vsapi->addNodeRef(vsnode[1]));
+    } catch (WobblyException &) {
+        vsapi->freeNode(node);
+        throw;
+    }
+
+    vsapi->freeNode(node);
+
+    evaluated_final_script = std::move(script);
+    final_display_matrix = matrix;
+    final_display_thumbnail_size = thumbnail_size;
 
     requestFrames(current_frame);
 }
 
 
 void WobblyWindow::evaluateMainDisplayScript() {
-    evaluateScript(false);
+    // The script only needs to run once per project. Matches and freeze frames
+    // are applied by a native filter reading them from the project, so edits
+    // keep the source node and its frame cache.
+    bool source_changed = !vsnode_main_source;
+
+    if (!vsnode_main_source) {
+        std::string script = project->generateMainDisplayScript(false);
+
+        script +=
+                "c.max_cache_size = " + std::to_string(settings_cache_spin->value()) + "\n";
+
+        if (vssapi->evaluateBuffer(vsscript, script.c_str(), (project_path.isEmpty() ? video_path : project_path).toUtf8().constData())) {
+            std::string error = vssapi->getError(vsscript);
+            // The traceback is mostly unnecessary noise.
+            size_t traceback = error.find("Traceback");
+            if (traceback != std::string::npos)
+                error.insert(traceback, 1, '\n');
+
+            throw WobblyException("Failed to evaluate main display script. Error message:\n" + error);
+        }
+
+        VSNode *node = vssapi->getOutputNode(vsscript, 0);
+        if (!node)
+            throw WobblyException("Main display script evaluated successfully, but no node found at output index 0.");
+
+        if (vsapi->getVideoInfo(node)->format.colorFamily == cfUndefined) {
+            vsapi->freeNode(node);
+            throw WobblyException("The output clip has unknown format. Wobbly cannot display such clips.");
+        }
+
+        vsnode_main_source = node;
+    }
+
+    int first_changed = 0;
+    int last_changed = INT_MAX;
+    bool overrides_changed = project->updateFrameOverrides(&first_changed, &last_changed);
+
+    std::string matrix, transfer, primaries;
+    getDisplayColorimetry(matrix, transfer, primaries);
+
+    const VSVideoInfo *vi = vsapi->getVideoInfo(vsnode_main_source);
+    QSize thumbnail_size;
+    if (vi->width && vi->height)
+        thumbnail_size = getThumbnailSize(QSize(vi->width, vi->height));
+
+    // Nothing changed, so the frames already displayed are still good.
+    bool display_changed = !vsnode[0] || source_changed || overrides_changed || matrix != main_display_matrix;
+    bool thumbnails_changed = display_changed || !vsnode_thumbnails[0] || thumbnail_size != main_display_thumbnail_size;
+
+    if (thumbnails_changed) {
+        // Edits of matches and freeze frames leave the other frames as they
+        // were, so those stay cached. The nodes are replaced all the same,
+        // because VapourSynth caches frames too.
+        bool only_overrides_changed = vsnode[0] && !source_changed && matrix == main_display_matrix;
+        if (!only_overrides_changed) {
+            first_changed = 0;
+            last_changed = INT_MAX;
+        }
+
+        VSNode *node = createOverridesFilter(vsapi, vscore, vsnode_main_source, project->getFrameOverrides());
+
+        if (display_changed)
+            setDisplayNode(false, false, createDisplayNode(node, QSize()), first_changed, last_changed);
+
+        bool same_thumbnails = vsnode_thumbnails[0] && thumbnail_size == main_display_thumbnail_size;
+
+        // Clips with variable dimensions are scaled by PackTask.
+        if (thumbnail_size.isValid())
+            setDisplayNode(false, true, createDisplayNode(node, thumbnail_size), first_changed, same_thumbnails ? last_changed : INT_MAX);
+        else
+            setDisplayNode(false, true, vsapi->addNodeRef(vsnode[0]), first_changed, same_thumbnails ? last_changed : INT_MAX);
+
+        vsapi->freeNode(node);
+
+        main_display_matrix = matrix;
+        main_display_thumbnail_size = thumbnail_size;
+    }
+
+    requestFrames(current_frame);
+}
+
+
+// Converts clip to RGB for display. If size is valid, the clip is also
+// shrunk to it, before the conversion, which saves most of the work.
+// Doesn't consume clip.
+VSNode *WobblyWindow::createDisplayNode(VSNode *clip, QSize size) {
+    std::string matrix, transfer, primaries;
+    getDisplayColorimetry(matrix, transfer, primaries);
+
+    VSMap *args = vsapi->createMap();
+    vsapi->mapSetNode(args, "clip", clip, maAppend);
+    if (size.isValid()) {
+        vsapi->mapSetInt(args, "width", size.width(), maAppend);
+        vsapi->mapSetInt(args, "height", size.height(), maAppend);
+    }
+    vsapi->mapSetInt(args, "format", pfRGB24, maAppend);
+    vsapi->mapSetData(args, "dither_type", "random", -1, dtUtf8, maAppend);
+    vsapi->mapSetData(args, "matrix_in_s", matrix.c_str(), -1, dtUtf8, maAppend);
+    vsapi->mapSetData(args, "transfer_in_s", transfer.c_str(), -1, dtUtf8, maAppend);
+    vsapi->mapSetData(args, "primaries_in_s", primaries.c_str(), -1, dtUtf8, maAppend);
+    return invokeFilter(vsapi, vscore, "resize", size.isValid() ? "Bilinear" : "Bicubic", args);
 }
 
 
@@ -4536,6 +4987,48 @@ void WobblyWindow::evaluateFinalScript() {
 }
 
 
+void WobblyWindow::updateCropOverlay() {
+    // The preview is cropped for real by the final script.
+    if (!project || preview || !crop_dock->isVisible() || !project->isCropEnabled()) {
+        frame_label->setCropOverlay(QMargins());
+        return;
+    }
+
+    const Crop &crop = project->getCrop();
+
+    frame_label->setCropOverlay(QMargins(crop.left, crop.top, crop.right, crop.bottom));
+}
+
+
+void WobblyWindow::resetMainDisplaySource() {
+    vsapi->freeNode(vsnode_main_source);
+    vsnode_main_source = nullptr;
+}
+
+
+void WobblyWindow::setDisplayNode(bool preview_node, bool thumbnails, VSNode *node, int first_changed, int last_changed) {
+    VSNode *&old_node = thumbnails ? vsnode_thumbnails[(int)preview_node] : vsnode[(int)preview_node];
+    int &generation = thumbnails ? vsnode_thumbnails_generation[(int)preview_node] : vsnode_generation[(int)preview_node];
+
+    vsapi->freeNode(old_node);
+    old_node = node;
+
+    // Frames still in flight from the old node will not be cached or displayed.
+    int old_generation = generation;
+    generation = ++last_generation;
+
+    if (first_changed == 0 && last_changed == INT_MAX)
+        frame_cache.removeGeneration(old_generation);
+    else
+        frame_cache.renameGeneration(old_generation, generation, first_changed, last_changed);
+}
+
+
+int WobblyWindow::getDisplayNodeGeneration(bool preview_node, bool thumbnails) const {
+    return thumbnails ? vsnode_thumbnails_generation[(int)preview_node] : vsnode_generation[(int)preview_node];
+}
+
+
 void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *, const char *errorMsg) {
     CallbackData *callback_data = (CallbackData *)userData;
 
@@ -4547,6 +5040,8 @@ void VS_CC frameDoneCallback(void *userData, const VSFrame *f, int n, VSNode *,
                               Q_ARG(void *, (void *)f),
                               Q_ARG(int, n),
                               Q_ARG(bool, callback_data->preview_node),
+                              Q_ARG(bool, callback_data->thumbnail),
+                              Q_ARG(int, callback_data->generation),
                               Q_ARG(QString, QString(errorMsg)));
     // Pass a copy of the error message because the pointer won't be valid after this function returns.
 
@@ -4567,14 +5062,9 @@ void WobblyWindow::requestFrames(int n) {
     current_pict_type.clear();
     updateFrameDetails();
 
-    if (!vsnode[(int)preview])
+    if (!vsnode[(int)preview] || !vsnode_thumbnails[(int)preview])
         return;
 
-    if (pending_requests && pending_requests_node == vsnode[(int)preview])
-        return;
-
-    pending_frame = n;
-
     int frame_num = n;
     int last_frame = project->getNumFrames(PostSource) - 1;
     if (preview) {
@@ -4582,6 +5072,19 @@ void WobblyWindow::requestFrames(int n) {
         last_frame = project->getNumFrames(PostDecimate) - 1;
     }
 
+    // Frames requested earlier that this position doesn't need are dropped when they arrive.
+    request_serial++;
+
+    // Re-requesting the same position, e.g. after an edit, doesn't interrupt the stepping.
+    if (frame_num != last_requested_frame) {
+        int stride = last_requested_frame < 0 ? 0 : frame_num - last_requested_frame;
+
+        read_ahead_stride = stride == last_stride ? stride : 0;
+
+        last_stride = stride;
+        last_requested_frame = frame_num;
+    }
+
     int num_thumbnails = settings_num_thumbnails_spin->value();
     int first_visible = (MAX_THUMBNAILS - num_thumbnails) / 2;
     int last_visible = first_visible + num_thumbnails - 1;
@@ -4592,70 +5095,235 @@ void WobblyWindow::requestFrames(int n) {
     for (int i = 0; i < num_thumbnails / 2 - (last_frame - frame_num); i++)
         thumb_labels[last_visible - i]->setPixmap(splash_thumb);
 
-    pending_requests_node = vsnode[(int)preview];
+    bool current_frame_cached = false;
+    bool all_requested = true;
 
-    for (int i = std::max(0, frame_num - num_thumbnails / 2); i < std::min(frame_num + num_thumbnails / 2 + 1, last_frame + 1); i++) {
-        pending_requests++;
-        CallbackData *callback_data = new CallbackData(this, vsapi->addNodeRef(vsnode[(int)preview]), preview, vsapi);
-        vsapi->getFrameAsync(i, vsnode[(int)preview], frameDoneCallback, (void *)callback_data);
+    // Only the frames not displayed recently are requested.
+    for (const FrameRequest &request : wantedFrames(frame_num, last_frame)) {
+        const CachedFrame *cached = frame_cache.find(getDisplayNodeGeneration(preview, request.thumbnail), request.frame);
+        if (cached) {
+            if (request.thumbnail) {
+                displayThumbnail(request.frame, *cached);
+            } else {
+                displayFrame(request.frame, *cached);
+
+                if (request.frame == frame_num)
+                    current_frame_cached = true;
+            }
+
+            continue;
+        }
+
+        // Frames already in flight are displayed when they arrive.
+        if (!fetchFrame(request.frame, request.thumbnail))
+            all_requested = false;
     }
 
-    // restoreOverrideCursor called in frameDone
-    QApplication::setOverrideCursor(Qt::BusyCursor);
+    // Otherwise frameDone calls requestFrames again when there is room.
+    if (all_requested)
+        pending_frame = n;
+
+    if (!current_frame_cached && !busy_cursor) {
+        // restoreOverrideCursor called in displayFrame
+        QApplication::setOverrideCursor(Qt::BusyCursor);
+        busy_cursor = true;
+    }
 }
 
 
-// Runs in the GUI thread.
-void WobblyWindow::frameDone(void *framev, int n, bool preview_node, const QString &errorMsg) {
-    const VSFrame *frame = (const VSFrame *)framev;
+// The frames needed at frame_num, in the displayed node's frame numbers.
+// The current frame comes first, so that VapourSynth starts with it,
+// then the thumbnails closest to it.
+// If the last steps all went the same way by the same amount, the frames
+// the next few steps will display come after, so that they can be decoded
+// while the current ones are being looked at.
+std::vector<WobblyWindow::FrameRequest> WobblyWindow::wantedFrames(int frame_num, int last_frame) const {
+    int num_thumbnails = settings_num_thumbnails_spin->value();
 
-    pending_requests--;
+    std::vector<FrameRequest> wanted;
 
-    if (!frame) {
-        // setOverrideCursor called in requestFrames
-        QApplication::restoreOverrideCursor();
+    wanted.push_back({ frame_num, false });
+
+    if (num_thumbnails > 0)
+        wanted.push_back({ frame_num, true });
+
+    for (int distance = 1; distance <= num_thumbnails / 2; distance++) {
+        if (frame_num - distance >= 0)
+            wanted.push_back({ frame_num - distance, true });
+        if (frame_num + distance <= last_frame)
+            wanted.push_back({ frame_num + distance, true });
+    }
+
+    if (!read_ahead_stride)
+        return wanted;
+
+    for (int step = 1; step <= settings_read_ahead_spin->value(); step++) {
+        int next = frame_num + step * read_ahead_stride;
+        if (next < 0 || next > last_frame)
+            break;
+
+        wanted.push_back({ next, false });
+
+        if (num_thumbnails <= 0)
+            continue;
+
+        for (int i = std::max(0, next - num_thumbnails / 2); i <= std::min(next + num_thumbnails / 2, last_frame); i++)
+            if (i < frame_num - num_thumbnails / 2 || i > frame_num + num_thumbnails / 2)
+                wanted.push_back({ i, true });
+    }
+
+    return wanted;
+}
+
+
+// Requests frame n from the displayed node, or from its thumbnail-sized
+// version, unless it was already requested.
+// Returns false if too many requests are in flight already.
+bool WobblyWindow::fetchFrame(int n, bool thumbnail) {
+    int generation = getDisplayNodeGeneration(preview, thumbnail);
+
+    auto it = frames_in_flight.find({ generation, n });
+    if (it != frames_in_flight.end()) {
+        // Still wanted.
+        it->second = request_serial;
+        return true;
+    }
+
+    // VapourSynth can't cancel requests, so only a few are allowed in flight
+    // while scrubbing. This way a new position doesn't wait for a long queue
+    // of frames nobody wants anymore. Frames still in flight from older nodes
+    // don't count.
+    size_t max_in_flight = (size_t)std::max(0, settings_num_thumbnails_spin->value()) + 1;
+    if (read_ahead_stride)
+        max_in_flight *= settings_read_ahead_spin->value() + 1;
+
+    size_t in_flight = 0;
+    for (bool thumbnails : { false, true }) {
+        int node_generation = getDisplayNodeGeneration(preview, thumbnails);
+        in_flight += std::distance(frames_in_flight.lower_bound({ node_generation, 0 }), frames_in_flight.lower_bound({ node_generation + 1, 0 }));
+    }
+    if (in_flight >= max_in_flight)
+        return false;
 
-        errorPopup(QStringLiteral("Failed to retrieve frame %1. Error message: %2").arg(n).arg(errorMsg).toUtf8().constData());
+    frames_in_flight.insert({ { generation, n }, request_serial });
 
+    VSNode *node = thumbnail ? vsnode_thumbnails[(int)preview] : vsnode[(int)preview];
+
+    CallbackData *callback_data = new CallbackData(this, vsapi->addNodeRef(node), preview, thumbnail, generation, vsapi);
+    vsapi->getFrameAsync(n, node, frameDoneCallback, (void *)callback_data);
+
+    return true;
+}
+
+
+void WobblyWindow::displayFrame(int n, const CachedFrame &cached) {
+    // Read ahead.
+    if (n != (preview ? project->frameNumberAfterDecimation(current_frame) : current_frame))
         return;
+
+    // The view may have changed.
+    updateCropOverlay();
+
+    // FrameLabel applies the zoom when painting.
+    frame_label->setPixmap(QPixmap::fromImage(cached.image));
+
+    if (busy_cursor) {
+        // setOverrideCursor called in requestFrames
+        QApplication::restoreOverrideCursor();
+        busy_cursor = false;
     }
 
-    // error pointer must be non-null to enable non-exceptional return in case of missing/bad property
-    int pict_type_error;
-    const char *pict_type_data = vsapi->mapGetData(vsapi->getFramePropertiesRO(frame), "_PictType", 0, &pict_type_error);
-    QString pict_type(pict_type_data ? pict_type_data : "&lt;unknown&gt;");
+    current_pict_type = cached.pict_type;
+    original_frame_width = cached.image.width();
+    original_frame_height = cached.image.height();
 
-    int width = vsapi->getFrameWidth(frame, 0);
-    int height = vsapi->getFrameHeight(frame, 0);
-    uint8_t *frame_data = packRGBFrame(vsapi, frame);
-    vsapi->freeFrame(frame);
+    // current_pict_type has changed
+    updateFrameDetails();
+}
 
-    QImage image = QImage(frame_data, width, height, width * 4, QImage::Format_RGB32, free, frame_data);
 
+void WobblyWindow::displayThumbnail(int n, const CachedFrame &cached) {
     int offset;
-    if (preview_node)
-        offset = n - project->frameNumberAfterDecimation(pending_frame);
+    if (preview)
+        offset = n - project->frameNumberAfterDecimation(current_frame);
     else
-        offset = n - pending_frame;
+        offset = n - current_frame;
 
-    if (offset == 0) {
-        int zoom = project->getZoom();
-        frame_label->setPixmap(QPixmap::fromImage(image).scaled(width * zoom, height * zoom, Qt::IgnoreAspectRatio, Qt::FastTransformation));
+    // Read ahead.
+    int num_thumbnails = settings_num_thumbnails_spin->value();
+    if (offset < -num_thumbnails / 2 || offset > num_thumbnails / 2)
+        return;
 
-        // setOverrideCursor called in requestFrames
-        QApplication::restoreOverrideCursor();
+    thumb_labels[offset + MAX_THUMBNAILS / 2]->setPixmap(QPixmap::fromImage(cached.image));
+}
 
-        current_pict_type = pict_type;
-        original_frame_width = width;
-        original_frame_height = height;
 
-        // current_pict_type has changed
-        updateFrameDetails();
+// Runs in the GUI thread.
+void WobblyWindow::frameDone(void *framev, int n, bool preview_node, bool thumbnail, int generation, const QString &errorMsg) {
+    const VSFrame *frame = (const VSFrame *)framev;
+
+    // Requested for a position that was left before the frame arrived,
+    // or by a node that was replaced in the meantime.
+    bool superseded = true;
+
+    auto it = frames_in_flight.find({ generation, n });
+    if (it != frames_in_flight.end())
+        superseded = it->second != request_serial || generation != getDisplayNodeGeneration(preview_node, thumbnail);
+
+    // A frame being packed stays in flight until frameReady.
+    if (it != frames_in_flight.end() && (!frame || superseded))
+        frames_in_flight.erase(it);
+
+    if (!frame) {
+        if (!superseded) {
+            if (busy_cursor) {
+                // setOverrideCursor called in requestFrames
+                QApplication::restoreOverrideCursor();
+                busy_cursor = false;
+            }
+
+            errorPopup(QStringLiteral("Failed to retrieve frame %1. Error message: %2").arg(n).arg(errorMsg).toUtf8().constData());
+        }
+    } else if (superseded) {
+        // Don't waste time packing and scaling it.
+        vsapi->freeFrame(frame);
+    } else {
+        // Frames from a proper thumbnail node already have this size.
+        QSize thumbnail_size;
+        if (thumbnail)
+            thumbnail_size = getThumbnailSize(QSize(vsapi->getFrameWidth(frame, 0), vsapi->getFrameHeight(frame, 0)));
+
+        pack_pool.start(new PackTask(this, vsapi, frame, n, preview_node, thumbnail, generation, thumbnail_size));
+
+        return;
     }
 
-    thumb_labels[offset + MAX_THUMBNAILS / 2]->setPixmap(getThumbnail(image));
+    if (pending_frame != current_frame)
+        requestFrames(current_frame);
+}
 
-    if (!pending_requests && pending_frame != current_frame)
+
+// Runs in the GUI thread, after a PackTask is done.
+void WobblyWindow::frameReady(int n, bool preview_node, bool thumbnail, int generation, const QImage &image, const QString &pict_type) {
+    frames_in_flight.erase({ generation, n });
+
+    // Frames from a node that was replaced in the meantime are stale.
+    if (generation == getDisplayNodeGeneration(preview_node, thumbnail)) {
+        CachedFrame cached;
+        cached.image = image;
+        cached.pict_type = pict_type;
+
+        frame_cache.insert(generation, n, cached);
+
+        if (preview_node == preview) {
+            if (thumbnail)
+                displayThumbnail(n, cached);
+            else
+                displayFrame(n, cached);
+        }
+    }
+
+    if (pending_frame != current_frame)
         requestFrames(current_frame);
 }
 
@@ -5263,12 +5931,16 @@ void WobblyWindow::toggleCombed() {
         cancelRange();
     }
 
-    if (project->isCombedFrame(current_frame))
-        for (int i = start; i <= end; i++)
-            project->deleteCombedFrame(i);
-    else
-        for (int i = start; i <= end; i++)
-            project->addCombedFrame(i);
+    {
+        BulkUpdate bulk_update(project);
+
+        if (project->isCombedFrame(current_frame))
+            for (int i = start; i <= end; i++)
+                project->deleteCombedFrame(i);
+        else
+            for (int i = start; i <= end; i++)
+                project->addCombedFrame(i);
+    }
 
     commit("Toggle combed");
 
@@ -5315,10 +5987,13 @@ void WobblyWindow::addSection() {
 
     const Section *section = project->findSection(current_frame);
     if (section->start != current_frame) {
+        // Adding a section can move the others in memory.
+        bool has_presets = section->presets.size();
+
         project->addSection(current_frame);
         commit("Add section");
 
-        if (preview && section->presets.size()) {
+        if (preview && has_presets) {
             try {
                 evaluateFinalScript();
             } catch (WobblyException &e) {
@@ -5937,7 +6612,11 @@ void WobblyWindow::updateUndoActions() {
     if (!project) {
         undo_action->setEnabled(false);
         redo_action->setEnabled(false);
+
+        settings_undo_memory_label->setText(QStringLiteral("none"));
     } else {
+        settings_undo_memory_label->setText(QStringLiteral("%1 KiB").arg(project->getUndoMemoryUsage() / 1024));
+
         std::string undo_text = project->getUndoDescription();
         std::string redo_text = project->getRedoDescription();
 
@@ -5981,11 +6660,9 @@ void WobblyWindow::zoom(bool in) {
     if ((!in && zoom > 1) || (in && zoom < 8)) {
         zoom += in ? 1 : -1;
         project->setZoom(zoom);
-        try {
-            requestFrames(current_frame);
-        } catch (WobblyException &e) {
-            errorPopup(e.what());
-        }
+
+        // No need to retrieve the frame again.
+        frame_label->setZoom(zoom);
     }
 
     zoom_label->setText(QStringLiteral("Zoom: %1x").arg(zoom));
@@ -6258,23 +6935,25 @@ void WobblyWindow::copyCurrentFrameNumberToClipboard() {
 void WobblyWindow::copyCurrentFrameImageToClipboard() {
     if(project != nullptr) {
         QClipboard *clipboard = QGuiApplication::clipboard();
-        clipboard->setPixmap(frame_label->pixmap(Qt::ReturnByValue).scaled(original_frame_width, original_frame_height, Qt::IgnoreAspectRatio, Qt::FastTransformation));
+        clipboard->setPixmap(frame_label->framePixmap());
     }
 }
 
 
-QSize WobblyWindow::getThumbnailSize(QSize image_size) {
-    QSize thumbnail_size;
+int WobblyWindow::getThumbnailHeight() {
     QRect desktop_rect = QApplication::desktop()->screenGeometry(this);
     double percentage = settings_thumbnail_size_dspin->value();
 
-    if (desktop_rect.width() >= desktop_rect.height()) {
-        thumbnail_size.setHeight((int)(desktop_rect.height() * percentage / 100));
-        thumbnail_size.setWidth((int)(image_size.width() * thumbnail_size.height() / image_size.height()));
-    } else {
-        thumbnail_size.setHeight((int)(desktop_rect.width() * percentage / 100));
-        thumbnail_size.setWidth((int)(image_size.width() * thumbnail_size.height() / image_size.height()));
-    }
+    return std::max(1, (int)(std::min(desktop_rect.width(), desktop_rect.height()) * percentage / 100));
+}
+
+
+// The final script computes the same size for its thumbnail output.
+QSize WobblyWindow::getThumbnailSize(QSize image_size) {
+    QSize thumbnail_size;
+
+    thumbnail_size.setHeight(getThumbnailHeight());
+    thumbnail_size.setWidth(std::max(1, image_size.width() * thumbnail_size.height() / image_size.height()));
 
     return thumbnail_size;
 }
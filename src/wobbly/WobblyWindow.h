@@ -36,11 +36,18 @@ SOFTWARE.
 #include <QSlider>
 #include <QSpinBox>
 #include <QStringListModel>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <climits>
+#include <map>
 
 #include <VapourSynth4.h>
 #include <VSScript4.h>
 
 #include "DockWidget.h"
+#include "FrameCache.h"
 #include "FrameLabel.h"
 #include "ImportWindow.h"
 #include "ListWidget.h"
@@ -106,6 +113,7 @@ private:
     QSpinBox *crop_spin[4];
     QGroupBox *crop_box;
     QCheckBox *crop_early_check;
+    QTimer *crop_timer; // Delays the preview's update until the crop stops changing.
     QSpinBox *resize_spin[2];
     QGroupBox *resize_box;
     QComboBox *resize_filter_combo;
@@ -180,9 +188,15 @@ private:
     QComboBox *application_style_combo;
     QCheckBox *settings_compact_projects_check;
     QCheckBox *settings_use_relative_paths_check;
+    QCheckBox *settings_binary_columns_check;
     QComboBox *settings_colormatrix_combo;
     QSpinBox *settings_cache_spin;
+    QSpinBox *settings_frame_cache_spin;
+    QSpinBox *settings_read_ahead_spin;
     SpinBox *settings_undo_steps_spin;
+    QSpinBox *settings_undo_memory_spin;
+    QLabel *settings_undo_memory_label;
+    QSpinBox *settings_autosave_spin;
     QCheckBox *settings_print_details_check;
     QCheckBox *settings_bookmark_description_check;
     QComboBox *settings_decimation_function_combo;
@@ -202,6 +216,8 @@ private:
 
     QSignalMapper *recent_menu_signal_mapper;
 
+    QLabel *saving_label;
+
 
     // Other stuff.
 
@@ -209,16 +225,40 @@ private:
     QString project_path;
     QString video_path;
 
+    // Projects are saved in another thread, from a snapshot.
+    QThread *save_thread = nullptr;
+    WobblyProject *save_snapshot = nullptr;
+    QString save_path;
+    bool save_is_autosave = false;
+    uint64_t save_modification_count = 0;
+    std::string save_error; // Written by save_thread.
+    QString queued_save_path; // Saved when save_thread finishes.
+
+    QTimer *autosave_timer;
+    uint64_t autosave_modification_count = 0;
+
     int current_frame = 0;
-    int pending_frame = 0;
-    int pending_requests = 0;
-    VSNode *pending_requests_node = nullptr; // Don't free, it's just a copy.
+    int pending_frame = 0; // Every frame it needs has been requested.
+    // (Generation, frame number) -> request_serial of the last position that wanted the frame.
+    std::map<std::pair<int, int>, int> frames_in_flight;
+    int request_serial = 0; // Incremented every time requestFrames is called.
+    // Navigation history, in the displayed node's frame numbers. Used to guess which frames come next.
+    int last_requested_frame = -1;
+    int last_stride = 0;
+    int read_ahead_stride = 0; // 0 if the navigation isn't steady.
+    QTimer *scrub_timer;
+    bool busy_cursor = false; // The current frame is being retrieved.
 
     QString match_pattern;
     QString decimation_pattern;
 
     bool preview = false;
 
+    struct FrameRequest {
+        int frame;
+        bool thumbnail; // From vsnode_thumbnails.
+    };
+
     struct Shortcut {
         QString keys;
         QString default_keys;
@@ -248,6 +288,25 @@ private:
     VSScript *vsscript = nullptr;
     VSCore *vscore = nullptr;
     VSNode *vsnode[2] = {};
+    VSNode *vsnode_thumbnails[2] = {}; // Same as vsnode, but already at the thumbnail size.
+    VSNode *vsnode_main_source = nullptr; // Trimmed source, before the overrides filter.
+
+    // Incremented every time one of the nodes in vsnode or vsnode_thumbnails is replaced.
+    int vsnode_generation[2] = {};
+    int vsnode_thumbnails_generation[2] = {};
+    int last_generation = 0;
+
+    FrameCache frame_cache;
+
+    // Packs and scales the frames retrieved for display, so that the GUI thread doesn't have to.
+    QThreadPool pack_pool;
+
+    // Used to tell when the nodes don't need replacing.
+    std::string evaluated_final_script;
+    std::string final_display_matrix;
+    QSize final_display_thumbnail_size;
+    std::string main_display_matrix;
+    QSize main_display_thumbnail_size;
 
 
     // Functions
@@ -305,10 +364,22 @@ private:
     void initialiseBookmarksWindow();
     void initialiseUIFromProject();
 
+    void getDisplayColorimetry(std::string &matrix, std::string &transfer, std::string &primaries) const;
     void evaluateScript(bool final_script);
     void evaluateMainDisplayScript();
     void evaluateFinalScript();
+    void updateCropOverlay();
+    void resetMainDisplaySource();
+    VSNode *createDisplayNode(VSNode *clip, QSize size);
+    // Only the frames from first_changed to last_changed look different with
+    // the new node. The cached frames of the old node are kept for the rest.
+    void setDisplayNode(bool preview_node, bool thumbnails, VSNode *node, int first_changed = 0, int last_changed = INT_MAX);
+    int getDisplayNodeGeneration(bool preview_node, bool thumbnails) const;
     void requestFrames(int n);
+    std::vector<FrameRequest> wantedFrames(int frame_num, int last_frame) const;
+    bool fetchFrame(int n, bool thumbnail);
+    void displayFrame(int n, const CachedFrame &cached);
+    void displayThumbnail(int n, const CachedFrame &cached);
     void updateFrameDetails();
 
     void errorPopup(const char *msg);
@@ -324,6 +395,10 @@ private:
     void realOpenProject(const QString &path);
     void realOpenVideo(const QString &path);
     void realSaveProject(const QString &path);
+    void startSave(const QString &path, bool autosave);
+    void finishSave();
+    void waitForSave();
+    void autosave();
     void realSaveScript(const QString &path);
     void realSaveTimecodes(const QString &path);
     void realSaveSections(const QString &path);
@@ -353,6 +428,7 @@ private:
     void copyCurrentFrameNumberToClipboard();
     void copyCurrentFrameImageToClipboard();
 
+    int getThumbnailHeight();
     QSize getThumbnailSize(QSize image_size);
     QPixmap getThumbnail(const QImage &image);
 
@@ -474,7 +550,8 @@ public slots:
     void updateAfterUndo();
 
     void vsLogPopup(int msgType, const QString &msg);
-    void frameDone(void *framev, int n, bool preview_node, const QString &errorMsg);
+    void frameDone(void *framev, int n, bool preview_node, bool thumbnail, int generation, const QString &errorMsg);
+    void frameReady(int n, bool preview_node, bool thumbnail, int generation, const QImage &image, const QString &pict_type);
 };
 
 #endif // WOBBLYWINDOW_H